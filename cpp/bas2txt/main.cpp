@@ -0,0 +1,381 @@
+#include "speccybasic/archive.h"
+#include "speccybasic/bas2txt.h"
+#include "speccybasic/batch.h"
+#include "speccybasic/mappedfile.h"
+#include "speccybasic/profile.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// TOOL_VERSION is provided by CMake. Fallback set to 1.0.
+#ifndef TOOL_VERSION
+#define TOOL_VERSION "1.0"
+#endif
+
+void PrintHelp() {
+    std::cout << "ZX Spectrum BASIC-to-Text Converter v" << TOOL_VERSION << "\n"
+              << "Usage: bas2txt [options] <input.bas> <output.txt>\n"
+              << "       bas2txt --batch <in.bas> <out.txt> [<in.bas> <out.txt> ...]\n"
+              << "       bas2txt --dir <input-dir> <output-dir>\n"
+              << "       bas2txt --manifest <file>\n"
+              << "       bas2txt --archive <in.zip|in.tar> <out.zip|out.tar>\n"
+              << "       bas2txt --analyze[=FILE] <input.bas|archive>... [-j N]\n"
+              << "       bas2txt -j <N> <batch options>\n\n"
+              << "Options:\n"
+              << "  -h, --help     Show this help message\n"
+              << "  -v, --version  Show version information\n"
+              << "  -j <N>         Decode N files at a time in batch mode (0 = all cores)\n"
+              << "  --lines <A-B>  Only list lines A to B (also A, A- or -B)\n"
+              << "  --stats[=FILE] Report phase times and counters as JSON (to FILE, or in\n"
+              << "                 place of the status line)\n\n"
+              << "Input may be a +3DOS file, a TAP or TZX tape image (the first program on\n"
+              << "it is listed) or a headerless program; the container is detected.\n\n"
+              << "Use - as the input or output to read stdin or write stdout, e.g.\n"
+              << "  cat game.bas | bas2txt - - | grep PRINT\n\n"
+              << "Batch options may be combined; every file is decoded in one run and a\n"
+              << "per-file report is printed at the end. A manifest lists one\n"
+              << "<input> <output> pair per line.\n\n"
+              << "--archive decodes every .bas, .tap and .tzx member of a ZIP, TAR or .tar.gz\n"
+              << "into .txt members of a new ZIP or TAR (picked by its extension), keeping the\n"
+              << "folder layout, without unpacking anything to disk.\n\n"
+              << "--analyze reports as JSON where each program's bytes go (tokens, strings,\n"
+              << "REMs, hidden number payloads and line overhead, per line), how often each\n"
+              << "token is used, and what rewriting literals as VAL \"n\", %n or NOT PI/SGN PI\n"
+              << "would save. Archives are read member by member in memory.\n";
+}
+
+// "-" names stdin/stdout; those are decoded line by line so a pipeline never buffers the whole program
+static void DecodeStream(const bas2txt::BasParser& parser, const std::string& input, const std::string& output,
+                         speccybasic::ConversionStats* stats, speccybasic::Diagnostics* warnings) {
+    std::FILE* inFile = stdin;
+    std::FILE* outFile = stdout;
+
+    if (input == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    } else {
+        inFile = std::fopen(input.c_str(), "rb");
+        if (!inFile) throw std::runtime_error("Could not open input file " + input);
+    }
+
+    if (output != "-") {
+        outFile = std::fopen(output.c_str(), "w");
+        if (!outFile) {
+            if (inFile != stdin) std::fclose(inFile);
+            throw std::runtime_error("Could not open output file " + output);
+        }
+    }
+
+    try {
+        parser.ParseStream(inFile, outFile, stats, warnings);
+    } catch (...) {
+        if (inFile != stdin) std::fclose(inFile);
+        if (outFile != stdout) std::fclose(outFile);
+        throw;
+    }
+
+    if (inFile != stdin) std::fclose(inFile);
+    bool failed = (outFile == stdout) ? std::fflush(stdout) != 0 : std::fclose(outFile) != 0;
+    if (failed) throw std::runtime_error("Could not write output file " + output);
+}
+
+// --lines: the whole program unless Enabled
+struct LineRange {
+    bool Enabled = false;
+    int First = 0;
+    int Last = 9999;
+};
+
+// Takes "A-B", "A", "A-" or "-B"
+static LineRange ParseLineRange(const std::string& spec) {
+    auto number = [&spec](size_t from, size_t to, int& value) {
+        auto result = std::from_chars(spec.data() + from, spec.data() + to, value);
+        return from < to && result.ec == std::errc() && result.ptr == spec.data() + to;
+    };
+
+    LineRange range;
+    range.Enabled = true;
+    size_t dash = spec.find('-');
+    bool valid;
+    if (dash == std::string::npos) {
+        valid = number(0, spec.size(), range.First);
+        range.Last = range.First;
+    } else {
+        valid = (dash == 0 || number(0, dash, range.First)) &&
+                (dash + 1 == spec.size() || number(dash + 1, spec.size(), range.Last)) && spec.size() > 1;
+    }
+    if (!valid || range.First > range.Last) throw std::runtime_error("Invalid line range: " + spec);
+    return range;
+}
+
+// All of stdin, for --lines, which needs the whole image to index it
+static std::vector<uint8_t> ReadStdin() {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0) {
+        data.insert(data.end(), chunk, chunk + got);
+    }
+    if (std::ferror(stdin)) throw std::runtime_error("Could not read input stream.");
+    return data;
+}
+
+// Decodes one file; failures are reported as exceptions so batch mode can carry on. A line above 9999
+// ends the listing with a warning rather than losing the lines before it.
+// Streams read as they decode, so their read time is part of the decode time.
+static void DecodeOne(const bas2txt::BasParser& parser, const std::string& input, const std::string& output,
+                      speccybasic::ConversionStats* stats, const LineRange& range, speccybasic::Diagnostics* warnings) {
+    if (!range.Enabled && (input == "-" || output == "-")) {
+        DecodeStream(parser, input, output, stats, warnings);
+        return;
+    }
+
+    speccybasic::ScopedTimer readTimer(stats ? &stats->ReadNs : nullptr);
+    // Decoded straight from the mapping, so the image is never copied
+    speccybasic::MappedFile file;
+    std::vector<uint8_t> piped;
+    const uint8_t* data;
+    size_t size;
+    if (input == "-") {
+        piped = ReadStdin();
+        data = piped.data();
+        size = piped.size();
+    } else {
+        if (!file.Open(input)) throw std::runtime_error("Could not open input file " + input);
+        data = file.Data();
+        size = file.Size();
+    }
+    readTimer.Stop();
+
+    std::string text;
+    if (range.Enabled) {
+        // Only the header walk touches every line; just the requested ones are decoded
+        speccybasic::ScopedTimer indexTimer(stats ? &stats->HeaderNs : nullptr);
+        bas2txt::LineIndex index = parser.BuildIndex(data, size, warnings);
+        indexTimer.Stop();
+        parser.ParseLines(data, index, range.First, range.Last, text, stats);
+    } else {
+        parser.Parse(data, size, text, stats, warnings);
+    }
+
+    speccybasic::ScopedTimer writeTimer(stats ? &stats->WriteNs : nullptr);
+    if (output == "-") {
+        if (std::fwrite(text.data(), 1, text.size(), stdout) != text.size() || std::fflush(stdout) != 0) {
+            throw std::runtime_error("Could not write output stream.");
+        }
+        return;
+    }
+
+    // Text mode keeps the platform's native line endings, as the old ofstream did
+    std::FILE* outFile = std::fopen(output.c_str(), "w");
+    if (!outFile) throw std::runtime_error("Could not open output file " + output);
+    size_t written = std::fwrite(text.data(), 1, text.size(), outFile);
+    std::fclose(outFile);
+    if (written != text.size()) throw std::runtime_error("Could not write output file " + output);
+}
+
+int main(int argc, char* argv[]) {
+    speccybasic::StatsOptions statsOptions;
+    speccybasic::StatsOptions analyzeOptions;
+    LineRange range;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") { PrintHelp(); return 0; }
+        if (arg == "-v" || arg == "--version") {
+            std::cout << "bas2txt version " << TOOL_VERSION << "\n";
+            return 0;
+        }
+        if (speccybasic::ParseStatsArgument(arg, statsOptions)) continue;
+        if (speccybasic::ParseAnalyzeArgument(arg, analyzeOptions)) continue;
+        if (arg == "--lines" || arg.rfind("--lines=", 0) == 0) {
+            try {
+                if (arg.size() > 7) {
+                    range = ParseLineRange(arg.substr(8));
+                } else if (i + 1 < argc) {
+                    range = ParseLineRange(argv[++i]);
+                } else {
+                    throw std::runtime_error("--lines needs a range such as 9000-9100");
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return 1;
+            }
+            continue;
+        }
+        args.push_back(arg);
+    }
+
+    const bas2txt::BasParser parser;
+
+    auto started = std::chrono::steady_clock::now();
+    uint64_t allocationsBefore = speccybasic::AllocationCount();
+    auto elapsedNs = [&]() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+    };
+
+    if (analyzeOptions.Enabled) {
+        try {
+            if (statsOptions.Enabled || range.Enabled) throw std::runtime_error("--analyze cannot be combined with --stats or --lines");
+            unsigned threads = 1;
+            speccybasic::InputSet inputs(speccybasic::ParseInputArguments(args, threads), [](const std::string& name) {
+                std::string extension = speccybasic::MemberExtension(name);
+                return extension == ".bas" || extension == ".tap" || extension == ".tzx";
+            });
+            if (inputs.Jobs().empty()) throw std::runtime_error("--analyze expects one or more programs or archives");
+
+            std::vector<speccybasic::AnalysisEntry> entries(inputs.Jobs().size());
+            auto results = speccybasic::RunBatch(inputs.Jobs(), threads, [&](const speccybasic::BatchJob& job,
+                                                                               speccybasic::Diagnostics& warnings) {
+                size_t index = &job - inputs.Jobs().data();
+                inputs.Read(index, [&](const uint8_t* data, size_t size) {
+                    entries[index].Analysis = speccybasic::AnalyzeProgram(data, size, &warnings);
+                });
+                return std::string("analyzed");
+            });
+
+            size_t failed = 0;
+            for (size_t n = 0; n < results.size(); n++) {
+                entries[n].Input = results[n].Job.Input;
+                entries[n].Success = results[n].Success;
+                entries[n].Warnings = results[n].Warnings;
+                if (!results[n].Success) {
+                    entries[n].Error = results[n].Message;
+                    failed++;
+                }
+            }
+            speccybasic::WriteStatsReport(analyzeOptions, speccybasic::FormatAnalysisJson("bas2txt", TOOL_VERSION, entries), std::cout);
+            return failed == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    speccybasic::ArchiveOptions archiveOptions;
+    try {
+        if (speccybasic::ParseArchiveArguments(args, archiveOptions)) {
+            if (statsOptions.Enabled) throw std::runtime_error("--stats is for files, not --archive");
+
+            auto rename = [](const std::string& name) {
+                std::string extension = speccybasic::MemberExtension(name);
+                bool program = extension == ".bas" || extension == ".tap" || extension == ".tzx";
+                return program ? speccybasic::ReplaceMemberExtension(name, ".txt") : std::string();
+            };
+            auto results = speccybasic::ConvertArchive(archiveOptions, rename,
+                [&](const speccybasic::BatchJob&, const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
+                    speccybasic::Diagnostics& warnings) {
+                    std::string text;
+                    if (range.Enabled) {
+                        bas2txt::LineIndex index = parser.BuildIndex(input.data(), input.size(), &warnings);
+                        parser.ParseLines(input.data(), index, range.First, range.Last, text);
+                    } else {
+                        parser.Parse(input.data(), input.size(), text, nullptr, &warnings);
+                    }
+                    output.assign(text.begin(), text.end());
+                    return std::string("decoded");
+                });
+            return speccybasic::PrintBatchReport(results, std::cout) == 0 ? 0 : 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (!args.empty() && speccybasic::IsBatchArgument(args[0])) {
+        try {
+            speccybasic::BatchOptions options = speccybasic::ParseBatchArguments(args, ".txt");
+
+            std::vector<speccybasic::StatsEntry> entries(options.Jobs.size());
+            auto results = speccybasic::RunBatch(options.Jobs, options.Threads, [&](const speccybasic::BatchJob& job,
+                                                                                   speccybasic::Diagnostics& warnings) {
+                speccybasic::StatsEntry& entry = entries[&job - options.Jobs.data()];
+                speccybasic::ScopedTimer totalTimer(statsOptions.Enabled ? &entry.TotalNs : nullptr);
+                DecodeOne(parser, job.Input, job.Output, statsOptions.Enabled ? &entry.Stats : nullptr, range, &warnings);
+                return std::string("decoded");
+            });
+
+            size_t failed;
+            if (statsOptions.Enabled && statsOptions.Path.empty()) {
+                // The JSON takes the place of the text report so stdout stays parseable
+                failed = std::count_if(results.begin(), results.end(), [](const speccybasic::BatchResult& r) { return !r.Success; });
+            } else {
+                failed = speccybasic::PrintBatchReport(results, std::cout);
+            }
+
+            if (statsOptions.Enabled) {
+                for (size_t n = 0; n < results.size(); n++) {
+                    entries[n].Input = results[n].Job.Input;
+                    entries[n].Output = results[n].Job.Output;
+                    entries[n].Success = results[n].Success;
+                    entries[n].Warnings = results[n].Warnings;
+                    if (!results[n].Success) entries[n].Error = results[n].Message;
+                }
+                std::string json = speccybasic::FormatStatsJson("bas2txt", TOOL_VERSION, entries,
+                                                                speccybasic::AllocationCount() - allocationsBefore, elapsedNs(), false);
+                speccybasic::WriteStatsReport(statsOptions, json, std::cout);
+            }
+            return failed == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (args.size() < 2) {
+        std::cout << "Usage: bas2txt <input.bas> <output.txt>\n"
+                  << "Try 'bas2txt --help' for details.\n";
+        return 0;
+    }
+
+    // Keep stdout clean for the listing when it is the output
+    std::ostream& status = (args[1] == "-") ? std::cerr : std::cout;
+    // A report without a file of its own replaces the status line
+    bool quiet = statsOptions.Enabled && statsOptions.Path.empty();
+
+    speccybasic::StatsEntry entry;
+    entry.Input = args[0];
+    entry.Output = args[1];
+
+    try {
+        DecodeOne(parser, args[0], args[1], statsOptions.Enabled ? &entry.Stats : nullptr, range, &entry.Warnings);
+        entry.Success = true;
+        if (!quiet) status << "Successfully decoded " << (args[0] == "-" ? "stdin" : args[0]) << " (v" << TOOL_VERSION << ")\n";
+    } catch (const std::exception& e) {
+        entry.Error = e.what();
+        if (!quiet) std::cerr << "Error: " << e.what() << "\n";
+    }
+    if (!quiet) {
+        for (const speccybasic::Diagnostic& diagnostic : entry.Warnings.Items) {
+            std::cerr << "Warning: " << args[0] << ": " << speccybasic::FormatDiagnostic(diagnostic) << "\n";
+        }
+    }
+
+    if (statsOptions.Enabled) {
+        entry.TotalNs = elapsedNs();
+        try {
+            std::string json = speccybasic::FormatStatsJson("bas2txt", TOOL_VERSION, { entry },
+                                                            speccybasic::AllocationCount() - allocationsBefore, entry.TotalNs, false);
+            speccybasic::WriteStatsReport(statsOptions, json, status);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    return entry.Success ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+#include "speccybasic/bas2txt.h"
+#include "speccybasic/number.h"
+#include "speccybasic/txt2bas.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_CORPUS_DIR
+#define BENCH_CORPUS_DIR "corpus"
+#endif
+
+namespace fs = std::filesystem;
+
+struct CorpusFile {
+    std::string Name;
+    std::string Path;
+    std::string Text;
+    std::vector<uint8_t> Bas;
+    size_t Lines = 0;
+};
+
+static std::string ReadText(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Could not open " + path);
+    std::ostringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+static std::vector<CorpusFile> LoadCorpus(const std::string& dir) {
+    std::vector<std::string> paths;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".txt") paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    txt2bas::BasConverter converter;
+    std::vector<CorpusFile> corpus;
+    for (const auto& path : paths) {
+        CorpusFile file;
+        file.Name = fs::path(path).stem().string();
+        file.Path = path;
+        file.Text = ReadText(path);
+        file.Bas = converter.Convert(file.Text).FileData;
+        file.Lines = std::count(file.Text.begin(), file.Text.end(), '\n');
+        corpus.push_back(std::move(file));
+    }
+    if (corpus.empty()) throw std::runtime_error("No .txt programs in " + dir);
+    return corpus;
+}
+
+static void SetThroughput(benchmark::State& state, size_t bytes, size_t lines) {
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.counters["lines/s"] = benchmark::Counter(static_cast<double>(state.iterations() * lines), benchmark::Counter::kIsRate);
+}
+
+// ParseLine is private, so it is timed through the serial Convert path, which is ParseLine per line
+// plus the header and line split around it
+static void BenchParseLine(benchmark::State& state, const CorpusFile* file) {
+    txt2bas::BasConverter converter;
+    converter.LineThreads = 1;
+    for (auto _ : state) {
+        txt2bas::ConversionResult result = converter.Convert(file->Text);
+        benchmark::DoNotOptimize(result.FileData.data());
+    }
+    SetThroughput(state, file->Text.size(), file->Lines);
+}
+
+// Disk read plus Convert with the default threading, as the txt2bas CLI does for one file
+static void BenchConvertFile(benchmark::State& state, const CorpusFile* file) {
+    txt2bas::BasConverter converter;
+    for (auto _ : state) {
+        std::string text = ReadText(file->Path);
+        txt2bas::ConversionResult result = converter.Convert(text);
+        benchmark::DoNotOptimize(result.FileData.data());
+    }
+    SetThroughput(state, file->Text.size(), file->Lines);
+}
+
+static void BenchParse(benchmark::State& state, const CorpusFile* file) {
+    bas2txt::BasParser parser;
+    for (auto _ : state) {
+        std::string text = parser.Parse(file->Bas);
+        benchmark::DoNotOptimize(text.data());
+    }
+    SetThroughput(state, file->Bas.size(), file->Lines);
+}
+
+// A mix of what literals look like in real listings: small integers, the 65535 edge, fractions and
+// values only the floating-point form can hold
+static void BenchPack(benchmark::State& state) {
+    std::mt19937 random(2026);
+    std::vector<double> values(4096);
+    for (size_t i = 0; i < values.size(); i++) {
+        switch (i % 4) {
+            case 0: values[i] = static_cast<double>(random() % 256); break;
+            case 1: values[i] = static_cast<double>(random() % 131072) - 65536.0; break;
+            case 2: values[i] = static_cast<double>(random() % 100000) / 100.0; break;
+            default: values[i] = std::ldexp(static_cast<double>(random()) - 2147483648.0, static_cast<int>(random() % 160) - 80); break;
+        }
+    }
+
+    for (auto _ : state) {
+        for (double value : values) {
+            speccybasic::SinclairNumber::Packed packed = speccybasic::SinclairNumber::Pack(value);
+            benchmark::DoNotOptimize(packed);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * values.size()));
+}
+
+// Keeps each benchmark's time per iteration (the median when --benchmark_repetitions is used) for
+// the baseline comparison, while printing the usual console table
+class BaselineReporter : public benchmark::ConsoleReporter {
+public:
+    std::map<std::string, double> Nanoseconds;
+
+    void ReportRuns(const std::vector<Run>& reports) override {
+        for (const Run& run : reports) {
+            if (run.error_occurred) continue;
+            bool median = run.run_type == Run::RT_Aggregate && run.aggregate_name == "median";
+            if (run.run_type == Run::RT_Iteration || median) {
+                double ns = run.GetAdjustedRealTime() * 1e9 / benchmark::GetTimeUnitMultiplier(run.time_unit);
+                Nanoseconds[run.run_name.str()] = ns;
+            }
+        }
+        ConsoleReporter::ReportRuns(reports);
+    }
+};
+
+static void SaveBaseline(const std::string& path, const std::map<std::string, double>& times) {
+    std::ofstream out(path);
+    if (!out.is_open()) throw std::runtime_error("Could not write baseline " + path);
+    out.precision(17);
+    out << "# benchmark\tns/iteration\n";
+    for (const auto& entry : times) out << entry.first << '\t' << entry.second << '\n';
+}
+
+static std::map<std::string, double> LoadBaseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) throw std::runtime_error("Could not read baseline " + path);
+    std::map<std::string, double> times;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.rfind('\t');
+        if (line.empty() || line[0] == '#' || tab == std::string::npos) continue;
+        times[line.substr(0, tab)] = std::strtod(line.c_str() + tab + 1, nullptr);
+    }
+    return times;
+}
+
+// Returns the number of benchmarks slower than baseline by more than maxRegression percent
+static size_t CompareBaseline(const std::map<std::string, double>& baseline, const std::map<std::string, double>& current,
+                              double maxRegression, std::ostream& report) {
+    size_t regressions = 0;
+    report << "\nComparison against baseline (fails above +" << maxRegression << "%):\n";
+    for (const auto& entry : current) {
+        auto base = baseline.find(entry.first);
+        if (base == baseline.end() || base->second <= 0) {
+            report << "  NEW        " << entry.first << "\n";
+            continue;
+        }
+        double change = (entry.second / base->second - 1.0) * 100.0;
+        bool regressed = change > maxRegression;
+        if (regressed) regressions++;
+        char delta[32];
+        std::snprintf(delta, sizeof(delta), "%+7.1f%%", change);
+        report << (regressed ? "  REGRESSED " : "  ok        ") << delta << "  " << entry.first << "\n";
+    }
+    return regressions;
+}
+
+static bool TakeOption(const std::string& arg, const std::string& name, std::string& value) {
+    if (arg.rfind(name + "=", 0) != 0) return false;
+    value = arg.substr(name.size() + 1);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string corpusDir = BENCH_CORPUS_DIR;
+    std::string savePath;
+    std::string baselinePath;
+    std::string maxRegression = "10";
+
+    // Our options are taken out before Google Benchmark sees the rest
+    std::vector<char*> passThrough;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i > 0 && (TakeOption(arg, "--corpus", corpusDir) || TakeOption(arg, "--save-baseline", savePath) ||
+                      TakeOption(arg, "--baseline", baselinePath) || TakeOption(arg, "--max-regression", maxRegression))) {
+            continue;
+        }
+        if (arg == "--help" || arg == "-h") {
+            std::cout << "Usage: speccybasic_bench [--corpus=DIR] [--save-baseline=FILE]\n"
+                      << "                         [--baseline=FILE [--max-regression=PCT]] [benchmark options]\n\n"
+                      << "  --corpus=DIR          Programs to measure (default " << BENCH_CORPUS_DIR << ")\n"
+                      << "  --save-baseline=FILE  Write the time of every benchmark to FILE\n"
+                      << "  --baseline=FILE       Compare against FILE and exit 1 on a regression\n"
+                      << "  --max-regression=PCT  Slowdown allowed before failing (default 10)\n\n";
+        }
+        passThrough.push_back(argv[i]);
+    }
+    int benchArgc = static_cast<int>(passThrough.size());
+
+    std::vector<CorpusFile> corpus;
+    try {
+        corpus = LoadCorpus(corpusDir);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    for (const CorpusFile& file : corpus) {
+        benchmark::RegisterBenchmark(("ParseLine/" + file.Name).c_str(), BenchParseLine, &file);
+        benchmark::RegisterBenchmark(("ConvertFile/" + file.Name).c_str(), BenchConvertFile, &file);
+        benchmark::RegisterBenchmark(("Parse/" + file.Name).c_str(), BenchParse, &file);
+    }
+    benchmark::RegisterBenchmark("SinclairNumber::Pack", BenchPack);
+
+    benchmark::Initialize(&benchArgc, passThrough.data());
+    if (benchmark::ReportUnrecognizedArguments(benchArgc, passThrough.data())) return 1;
+
+    BaselineReporter reporter;
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+
+    try {
+        if (!savePath.empty()) {
+            SaveBaseline(savePath, reporter.Nanoseconds);
+            std::cout << "Saved baseline to " << savePath << "\n";
+        }
+        if (!baselinePath.empty()) {
+            size_t regressions = CompareBaseline(LoadBaseline(baselinePath), reporter.Nanoseconds,
+                                                 std::strtod(maxRegression.c_str(), nullptr), std::cout);
+            if (regressions > 0) {
+                std::cout << regressions << " benchmark(s) regressed\n";
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
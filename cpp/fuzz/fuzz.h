@@ -0,0 +1,133 @@
+#ifndef SPECCYBASIC_FUZZ_H
+#define SPECCYBASIC_FUZZ_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "speccybasic/bas2txt.h"
+#include "speccybasic/txt2bas.h"
+#include "reference/bas2txt_reference.h"
+#include "reference/txt2bas_reference.h"
+
+// Shared by the fuzz targets: the current converters, the frozen reference ones, and the failure report.
+// Every target defines LLVMFuzzerTestOneInput, so the same file runs under libFuzzer, AFL++ or the
+// standalone driver.
+namespace fuzz {
+
+    // The reference tokenizer matches line numbers with std::regex, which recurses once per character;
+    // longer inputs only find stack limits, not differences
+    constexpr size_t MaxInputLength = 4096;
+
+    // What one converter did with one input: its output, or that it threw
+    struct Outcome {
+        bool Threw = false;
+        std::string Data;
+
+        bool operator==(const Outcome& other) const { return Threw == other.Threw && Data == other.Data; }
+        bool operator!=(const Outcome& other) const { return !(*this == other); }
+    };
+
+    // Auto takes the 48K path wherever it can, so NextBasic is checked separately to cover the full tokenizer.
+    // With a cache, lines it holds are copied instead and the rest are added to it.
+    inline Outcome Tokenize(std::string_view text, txt2bas::Dialect dialect = txt2bas::Dialect::Auto,
+                            txt2bas::LineCache* cache = nullptr) {
+        Outcome outcome;
+        try {
+            txt2bas::BasConverter converter;
+            converter.LineThreads = 1;
+            converter.Language = dialect;
+            std::vector<uint8_t> image = converter.Convert(text, nullptr, cache).FileData;
+            outcome.Data.assign(image.begin(), image.end());
+        } catch (const std::exception&) {
+            outcome.Threw = true;
+        }
+        return outcome;
+    }
+
+    inline Outcome ReferenceTokenize(std::string_view text) {
+        Outcome outcome;
+        try {
+            txt2bas_reference::BasConverter converter;
+            std::vector<uint8_t> basic = converter.ConvertText(std::string(text));
+            std::vector<uint8_t> header = txt2bas_reference::Plus3Dos::CreateHeader(static_cast<int>(basic.size()), converter.AutoStartLine);
+            outcome.Data.assign(header.begin(), header.end());
+            outcome.Data.append(basic.begin(), basic.end());
+        } catch (const std::exception&) {
+            outcome.Threw = true;
+        }
+        return outcome;
+    }
+
+    // TAP and TZX images are decoded since the reference was frozen, so it cannot judge them. Raw
+    // programs with either start are degenerate anyway: line 4864 of length 0, or a line beyond 9999.
+    inline bool IsTapeImage(const std::vector<uint8_t>& data) {
+        static const char tzx[] = "ZXTape!\x1A";
+        bool tap = data.size() >= 4 && data[0] == 19 && data[1] == 0 && data[2] == 0 && data[3] == 0;
+        return tap || (data.size() >= 8 && std::equal(tzx, tzx + 8, data.begin()));
+    }
+
+    inline Outcome Detokenize(const std::vector<uint8_t>& data) {
+        Outcome outcome;
+        try {
+            outcome.Data = bas2txt::BasParser().Parse(data);
+        } catch (const std::exception&) {
+            outcome.Threw = true;
+        }
+        return outcome;
+    }
+
+    inline Outcome ReferenceDetokenize(const std::vector<uint8_t>& data) {
+        Outcome outcome;
+        try {
+            outcome.Data = bas2txt_reference::BasParser().Parse(data);
+        } catch (const std::exception&) {
+            outcome.Threw = true;
+        }
+        return outcome;
+    }
+
+    inline std::vector<uint8_t> Bytes(const std::string& data) { return std::vector<uint8_t>(data.begin(), data.end()); }
+
+    inline void PrintOutcome(const char* label, const Outcome& outcome) {
+        std::fprintf(stderr, "%s: ", label);
+        if (outcome.Threw) {
+            std::fprintf(stderr, "threw\n");
+            return;
+        }
+        std::fprintf(stderr, "%zu bytes:", outcome.Data.size());
+        for (size_t i = 0; i < outcome.Data.size() && i < 256; i++) std::fprintf(stderr, " %02x", static_cast<uint8_t>(outcome.Data[i]));
+        std::fprintf(stderr, outcome.Data.size() > 256 ? " ...\n" : "\n");
+    }
+
+    // Saves the input as mismatch-<hash> and aborts; libFuzzer also keeps its own crash-* copy
+    [[noreturn]] inline void Fail(const char* check, const uint8_t* data, size_t size, const Outcome& expected, const Outcome& actual) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) hash = (hash ^ data[i]) * 1099511628211ull;
+
+        char path[64];
+        std::snprintf(path, sizeof(path), "mismatch-%016llx", static_cast<unsigned long long>(hash));
+        if (std::FILE* file = std::fopen(path, "wb")) {
+            std::fwrite(data, 1, size, file);
+            std::fclose(file);
+        }
+
+        std::fprintf(stderr, "\n%s differs from what was expected; input saved to %s\n", check, path);
+        PrintOutcome("expected", expected);
+        PrintOutcome("actual  ", actual);
+        std::abort();
+    }
+
+    inline void Check(const char* check, const uint8_t* data, size_t size, const Outcome& expected, const Outcome& actual) {
+        if (expected != actual) Fail(check, data, size, expected, actual);
+    }
+
+} // namespace fuzz
+
+#endif // SPECCYBASIC_FUZZ_H
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "fuzz.h"
+
+// Random text through the tokenizer with a line cache: cold into an empty cache, warm from it, warm
+// from its sidecar, and warm from a cache filled under each other dialect. Every image must match
+// the same dialect's uncached conversion byte for byte.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > fuzz::MaxInputLength) return 0;
+
+    std::string_view text(reinterpret_cast<const char*>(data), size);
+    const txt2bas::Dialect dialects[] = { txt2bas::Dialect::Auto, txt2bas::Dialect::NextBasic, txt2bas::Dialect::Sinclair48K };
+    for (txt2bas::Dialect dialect : dialects) {
+        fuzz::Outcome expected = fuzz::Tokenize(text, dialect);
+
+        txt2bas::LineCache cache;
+        fuzz::Check("Tokenize (cold cache)", data, size, expected, fuzz::Tokenize(text, dialect, &cache));
+        fuzz::Check("Tokenize (warm cache)", data, size, expected, fuzz::Tokenize(text, dialect, &cache));
+
+        txt2bas::LineCache loaded;
+        std::vector<uint8_t> sidecar = cache.Serialize();
+        loaded.Deserialize(sidecar.data(), sidecar.size());
+        fuzz::Check("Tokenize (cache from sidecar)", data, size, expected, fuzz::Tokenize(text, dialect, &loaded));
+
+        for (txt2bas::Dialect other : dialects) {
+            txt2bas::LineCache shared;
+            fuzz::Tokenize(text, other, &shared);
+            fuzz::Check("Tokenize (cache filled in another dialect)", data, size, expected, fuzz::Tokenize(text, dialect, &shared));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "fuzz.h"
+
+// Random bytes through the current and the reference detokenizer. The first byte picks how the rest
+// becomes a .bas image:
+//   0  used as is, so headers, banked markers and line lengths are all fuzzed (tape images aside)
+//   1  tokenized first, so DecodeLineData sees real keyword and number streams
+//   2  wrapped as the body of a single line, so every byte reaches DecodeLineData
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size == 0 || size > fuzz::MaxInputLength) return 0;
+
+    const uint8_t* payload = data + 1;
+    size_t length = size - 1;
+    std::vector<uint8_t> image;
+
+    switch (data[0] % 3) {
+        case 0:
+            image.assign(payload, payload + length);
+            if (fuzz::IsTapeImage(image)) return 0;
+            break;
+        case 1: {
+            fuzz::Outcome tokenized = fuzz::Tokenize(std::string_view(reinterpret_cast<const char*>(payload), length));
+            if (tokenized.Threw) return 0;
+            image = fuzz::Bytes(tokenized.Data);
+            break;
+        }
+        default:
+            image = { 0x00, 0x0A, static_cast<uint8_t>(length & 0xFF), static_cast<uint8_t>(length >> 8) };
+            image.insert(image.end(), payload, payload + length);
+            break;
+    }
+
+    fuzz::Check("Detokenize", data, size, fuzz::ReferenceDetokenize(image), fuzz::Detokenize(image));
+    return 0;
+}
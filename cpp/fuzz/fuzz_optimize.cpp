@@ -0,0 +1,117 @@
+#include "fuzz.h"
+#include "speccybasic/tokens.h"
+
+// Random text through txt2bas --optimize in each dialect. Nothing to compare with in the reference, so
+// the checks are invariants: every line keeps its number and its 0x0D, every number marker keeps its
+// five payload bytes, and, wherever the plain program already survives bas2txt and txt2bas again, the
+// optimized one does too. Dropped spaces are checked apart, as they come back from bas2txt.
+namespace {
+
+    struct Program {
+        bool Threw = false;
+        std::vector<uint8_t> Image;
+    };
+
+    Program Convert(std::string_view text, txt2bas::Dialect dialect, const txt2bas::OptimizeOptions& options) {
+        Program program;
+        try {
+            txt2bas::BasConverter converter;
+            converter.LineThreads = 1;
+            converter.Language = dialect;
+            converter.Optimize = options;
+            program.Image = converter.Convert(text).FileData;
+        } catch (const std::exception&) {
+            program.Threw = true;
+        }
+        return program;
+    }
+
+    // Each line's number, then "ok" or where it went wrong, walking the body as bas2txt does
+    std::string Structure(const std::vector<uint8_t>& image) {
+        std::string out;
+        size_t pos = txt2bas::Plus3Dos::HeaderSize;
+        while (pos + 4 <= image.size()) {
+            out += std::to_string((image[pos] << 8) | image[pos + 1]) + ":";
+            size_t length = image[pos + 2] | (image[pos + 3] << 8);
+            const uint8_t* body = image.data() + pos + 4;
+            pos += 4;
+            if (length == 0 || pos + length > image.size() || body[length - 1] != 0x0D) return out + "bad length";
+
+            bool inString = false;
+            int last = -1;
+            for (size_t i = 0; i + 1 < length; i++) {
+                uint8_t c = body[i];
+                if (c == '"') inString = !inString;
+                if (inString || c == '"') continue;
+                if ((speccybasic::TokenAttributes[c] & speccybasic::RestOfLine) || (c == ';' && (last == -1 || last == ':'))) break;
+                if (c == 0x0D) return out + "0x0D inside line";
+                if (c == 0x0E) {
+                    if (i + 6 > length - 1) return out + "short payload";
+                    i += 5;
+                }
+                if (c != ' ') last = c;
+            }
+            pos += length;
+            out += "ok ";
+        }
+        return pos == image.size() ? out : out + "trailing bytes";
+    }
+
+    fuzz::Outcome AsOutcome(const std::string& data) {
+        fuzz::Outcome outcome;
+        outcome.Data = data;
+        return outcome;
+    }
+
+    fuzz::Outcome AsOutcome(const Program& program) {
+        fuzz::Outcome outcome;
+        outcome.Threw = program.Threw;
+        outcome.Data.assign(program.Image.begin(), program.Image.end());
+        return outcome;
+    }
+
+    std::string WithoutSpaces(std::string text) {
+        text.erase(std::remove(text.begin(), text.end(), ' '), text.end());
+        return text;
+    }
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > fuzz::MaxInputLength) return 0;
+
+    std::string_view text(reinterpret_cast<const char*>(data), size);
+    // Bytes typed into the listing are copied through as they stand, but a 0x0E then reads as a number
+    // marker over whatever follows, and a REM token as a REM over text that was tokenized after all
+    for (uint8_t c : text) {
+        if (c == 0x0E || (speccybasic::TokenAttributes[c] & speccybasic::RestOfLine)) return 0;
+    }
+    txt2bas::OptimizeOptions rewrites;
+    rewrites.Rems = rewrites.Numbers = rewrites.ValStrings = true;
+    txt2bas::OptimizeOptions all = rewrites;
+    all.Spaces = true;
+
+    for (txt2bas::Dialect dialect : { txt2bas::Dialect::Auto, txt2bas::Dialect::NextBasic, txt2bas::Dialect::Sinclair48K }) {
+        Program plain = Convert(text, dialect, txt2bas::OptimizeOptions());
+        if (plain.Threw) return 0;
+        std::string layout = Structure(plain.Image);
+
+        Program rewritten = Convert(text, dialect, rewrites);
+        Program smallest = Convert(text, dialect, all);
+        fuzz::Check("--optimize lines", data, size, AsOutcome(layout), AsOutcome(Structure(rewritten.Image)));
+        fuzz::Check("--optimize=all lines", data, size, AsOutcome(layout), AsOutcome(Structure(smallest.Image)));
+
+        fuzz::Outcome listing = fuzz::Detokenize(rewritten.Image);
+        fuzz::Outcome compact = fuzz::Detokenize(smallest.Image);
+        fuzz::Check("--optimize=all against --optimize without spaces", data, size, AsOutcome(WithoutSpaces(listing.Data)),
+                    AsOutcome(WithoutSpaces(compact.Data)));
+
+        // The tokenizer is not idempotent on arbitrary text, so only listings it reads back unchanged count
+        fuzz::Outcome plainListing = fuzz::Detokenize(plain.Image);
+        if (plainListing.Threw || listing.Threw || listing.Data.size() > fuzz::MaxInputLength) continue;
+        if (Convert(plainListing.Data, dialect, txt2bas::OptimizeOptions()).Image != plain.Image) continue;
+        fuzz::Check("txt2bas(bas2txt(optimized))", data, size, AsOutcome(rewritten),
+                    AsOutcome(Convert(listing.Data, dialect, txt2bas::OptimizeOptions())));
+    }
+    return 0;
+}
@@ -0,0 +1,23 @@
+#include "fuzz.h"
+
+// bas2txt(txt2bas(x)) and one more tokenize pass over that listing, each stage checked against the
+// reference pipeline. The JS-compatible tokenizer is not idempotent on arbitrary text (stray spaces
+// and lower-case keyword fragments move on every pass), so stability is measured against today's
+// output rather than as a fixed point.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > fuzz::MaxInputLength) return 0;
+
+    std::string_view text(reinterpret_cast<const char*>(data), size);
+    fuzz::Outcome expected = fuzz::ReferenceTokenize(text);
+    fuzz::Outcome actual = fuzz::Tokenize(text);
+    fuzz::Check("txt2bas", data, size, expected, actual);
+    if (actual.Threw) return 0;
+
+    fuzz::Outcome expectedText = fuzz::ReferenceDetokenize(fuzz::Bytes(expected.Data));
+    fuzz::Outcome actualText = fuzz::Detokenize(fuzz::Bytes(actual.Data));
+    fuzz::Check("bas2txt(txt2bas(x))", data, size, expectedText, actualText);
+    if (actualText.Threw || actualText.Data.size() > fuzz::MaxInputLength) return 0;
+
+    fuzz::Check("txt2bas(bas2txt(txt2bas(x)))", data, size, fuzz::ReferenceTokenize(expectedText.Data), fuzz::Tokenize(actualText.Data));
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include "fuzz.h"
+
+// Random text through the current and the reference tokenizer (ParseLine plus the line split,
+// #autostart and header around it); the .bas images must match byte for byte
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > fuzz::MaxInputLength) return 0;
+
+    std::string_view text(reinterpret_cast<const char*>(data), size);
+    fuzz::Outcome expected = fuzz::ReferenceTokenize(text);
+    fuzz::Check("Tokenize", data, size, expected, fuzz::Tokenize(text));
+    fuzz::Check("Tokenize (NextBASIC)", data, size, expected, fuzz::Tokenize(text, txt2bas::Dialect::NextBasic));
+    return 0;
+}
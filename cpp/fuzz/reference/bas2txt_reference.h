@@ -1,12 +1,12 @@
-#ifndef BAS2TXT_H
-#define BAS2TXT_H
+#ifndef BAS2TXT_REFERENCE_H
+#define BAS2TXT_REFERENCE_H
 
 #include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
 
-namespace bas2txt {
+namespace bas2txt_reference {
 
     class ReverseTokenMap {
     public:
@@ -23,6 +23,6 @@ namespace bas2txt {
         std::string Parse(const std::vector<uint8_t>& data);
     };
 
-} // namespace bas2txt
+} // namespace bas2txt_reference
 
-#endif // BAS2TXT_H
\ No newline at end of file
+#endif // BAS2TXT_REFERENCE_H
\ No newline at end of file
@@ -1,17 +1,15 @@
-#include "txt2bas.h"
-#include <fstream>
-#include <iostream>
+// Frozen copy of the original regex-based txt2bas, kept as the oracle for the differential fuzzers.
+// Only the namespace, the header name and ConvertFile -> ConvertText (no file read) differ from the
+// first release; do not optimise or fix anything here.
+#include "txt2bas_reference.h"
 #include <regex>
+#include <stdexcept>
 #include <algorithm>
 #include <cctype>
 #include <cmath>
 #include <sstream>
 
-#ifndef TOOL_VERSION
-#define TOOL_VERSION "1.0"
-#endif
-
-namespace txt2bas {
+namespace txt2bas_reference {
 
     std::vector<uint8_t> Plus3Dos::CreateHeader(int basicLength, int autoStartLine) {
         std::vector<uint8_t> header(128, 0);
@@ -159,23 +157,9 @@ namespace txt2bas {
         });
     }
 
-    std::vector<uint8_t> BasConverter::ConvertFile(const std::string& path) {
+    std::vector<uint8_t> BasConverter::ConvertText(const std::string& text) {
         std::vector<uint8_t> output;
 
-        // Open safely as a binary array to avoid missing line breaks and carriage returns (\r)
-        std::ifstream file(path, std::ios::binary | std::ios::ate);
-        if (!file.is_open()) throw std::runtime_error("Could not open file: " + path);
-
-        std::streamsize size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        std::string text(size, '\0');
-        if (size > 0) {
-            if (!file.read(&text[0], size)) {
-                throw std::runtime_error("Failed to read file.");
-            }
-        }
-        file.close();
-
         // Exact match of index.mjs text.split(text.includes('\r') ? '\r' : '\n')
         // to securely segment Classic Mac \r files vs modern \n files without ignoring content.
         std::vector<std::string> lines;
@@ -748,48 +732,4 @@ namespace txt2bas {
 
         return finalLine;
     }
-}
-
-void PrintHelp() {
-    std::cout << "  _______     _   ___  ___          \n"
-              << " |__   __|   | | |__ \\|  _ \\         \n"
-              << "    | |___  _| |_   ) | |_) | __ _ ___\n"
-              << "    | / \\ \\/ / __| / /|  _ < / _` / __|\n"
-              << "    | |  >  <| |_ / /_| |_) | (_| \\__ \\\n"
-              << "    |_| /_/\\_\\\\__|____|____/ \\__,_|___/\n\n"
-              << "ZX Spectrum Text-to-BASIC Converter v" << TOOL_VERSION << "\n\n"
-              << "Usage: txt2bas [options] <input.txt> <output.bas>\n\n"
-              << "Options:\n"
-              << "  -h, --help     Show this help message and exit\n"
-              << "  -v, --version  Show version information and exit\n";
-}
-
-int main(int argc, char* argv[]) {
-    if (argc >= 2) {
-        std::string arg1 = argv[1];
-        if (arg1 == "-h" || arg1 == "--help") { PrintHelp(); return 0; }
-        if (arg1 == "-v" || arg1 == "--version") { std::cout << "txt2bas version " << TOOL_VERSION << "\n"; return 0; }
-    }
-    if (argc < 3) {
-        std::cout << "Usage: txt2bas <input.txt> <output.bas>\n";
-        return 0;
-    }
-
-    try {
-        txt2bas::BasConverter converter;
-        std::vector<uint8_t> basData = converter.ConvertFile(argv[1]);
-        std::vector<uint8_t> header = txt2bas::Plus3Dos::CreateHeader(basData.size(), converter.AutoStartLine);
-
-        std::ofstream out(argv[2], std::ios::binary);
-        if (!out.is_open()) throw std::runtime_error("Could not open output file.");
-
-        out.write(reinterpret_cast<const char*>(header.data()), header.size());
-        out.write(reinterpret_cast<const char*>(basData.data()), basData.size());
-        out.close();
-
-        std::cout << "Success! Created " << argv[2] << " (" << basData.size() << " bytes)\n";
-    } catch (const std::exception& ex) {
-        std::cout << "Error: " << ex.what() << "\n";
-    }
-    return 0;
-}
+} // namespace txt2bas_reference
@@ -1,12 +1,12 @@
-#ifndef TXT2BAS_H
-#define TXT2BAS_H
+#ifndef TXT2BAS_REFERENCE_H
+#define TXT2BAS_REFERENCE_H
 
 #include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
 
-namespace txt2bas {
+namespace txt2bas_reference {
 
     class Plus3Dos {
     public:
@@ -35,9 +35,9 @@ namespace txt2bas {
         int AutoStartLine = 32768;
 
         BasConverter();
-        std::vector<uint8_t> ConvertFile(const std::string& path);
+        std::vector<uint8_t> ConvertText(const std::string& text);
     };
 
-} // namespace txt2bas
+} // namespace txt2bas_reference
 
-#endif // TXT2BAS_H
\ No newline at end of file
+#endif // TXT2BAS_REFERENCE_H
\ No newline at end of file
@@ -0,0 +1,159 @@
+// Driver for compilers without libFuzzer (GCC, MSVC). It replays the given files and directories
+// through LLVMFuzzerTestOneInput, then mutates them at random on every core. It is not coverage
+// guided; use the libFuzzer build under Clang for deep runs.
+#include "speccybasic/workpool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace fs = std::filesystem;
+
+using Input = std::vector<uint8_t>;
+
+// Fragments that steer mutations towards the tokenizer's interesting paths
+static const std::string_view Dictionary[] = {
+    " THEN ", "IF ", "REM ", "DATA ", "DEF FN ", "GO TO ", "GOTO", " TO ", "PRINT ", "LET ", "BIN ",
+    "\"", ":", "%", ".", "$", "@", "(", ")", ",", ";", "=", "<>", "<=", ">=", "e+", "E-", ".5", "0x",
+    "65535", "65536", "1e38", "9999", "10000", "\r", "\n", "\r\n", " ", "\t", "#autostart ", "#program ",
+    "\x0e", "\xa5", "\xff", "\x7f", "\x60",
+};
+
+static void LoadInputs(const fs::path& path, std::vector<Input>& inputs) {
+    if (fs::is_directory(path)) {
+        std::vector<fs::path> entries;
+        for (const auto& entry : fs::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file()) entries.push_back(entry.path());
+        }
+        std::sort(entries.begin(), entries.end());
+        for (const auto& entry : entries) LoadInputs(entry, inputs);
+        return;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Could not open " + path.string());
+    inputs.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void Mutate(Input& input, const std::vector<Input>& pool, std::mt19937_64& random, size_t maxLength) {
+    size_t steps = 1 + random() % 4;
+    for (size_t step = 0; step < steps; step++) {
+        size_t at = input.empty() ? 0 : random() % (input.size() + 1);
+        switch (random() % 7) {
+            case 0: // flip a bit
+                if (!input.empty()) input[random() % input.size()] ^= static_cast<uint8_t>(1u << (random() % 8));
+                break;
+            case 1: // replace a byte
+                if (!input.empty()) input[random() % input.size()] = static_cast<uint8_t>(random());
+                break;
+            case 2: { // insert a dictionary fragment
+                std::string_view word = Dictionary[random() % std::size(Dictionary)];
+                input.insert(input.begin() + at, word.begin(), word.end());
+                break;
+            }
+            case 3: { // delete a run
+                if (input.empty()) break;
+                size_t from = random() % input.size();
+                size_t count = 1 + random() % std::min<size_t>(16, input.size() - from);
+                input.erase(input.begin() + from, input.begin() + from + count);
+                break;
+            }
+            case 4: { // duplicate a run
+                if (input.empty()) break;
+                size_t from = random() % input.size();
+                size_t count = 1 + random() % std::min<size_t>(32, input.size() - from);
+                Input run(input.begin() + from, input.begin() + from + count);
+                input.insert(input.begin() + at, run.begin(), run.end());
+                break;
+            }
+            case 5: { // splice in part of another input
+                if (pool.empty()) break;
+                const Input& other = pool[random() % pool.size()];
+                if (other.empty()) break;
+                size_t from = random() % other.size();
+                size_t count = 1 + random() % std::min<size_t>(256, other.size() - from);
+                input.insert(input.begin() + at, other.begin() + from, other.begin() + from + count);
+                break;
+            }
+            default: // insert a random byte
+                input.insert(input.begin() + at, static_cast<uint8_t>(random()));
+                break;
+        }
+    }
+    if (input.size() > maxLength) input.resize(maxLength);
+}
+
+static bool TakeOption(const std::string& arg, const char* name, unsigned long long& value) {
+    std::string prefix = std::string(name) + "=";
+    if (arg.rfind(prefix, 0) != 0) return false;
+    value = std::strtoull(arg.c_str() + prefix.size(), nullptr, 10);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long long runs = 0;
+    unsigned long long jobs = 0;
+    unsigned long long seed = 1;
+    unsigned long long maxLength = 2048;
+    std::vector<Input> seeds;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "-h" || arg == "--help") {
+                std::cout << "Usage: " << argv[0] << " [-runs=N] [-jobs=N] [-seed=N] [-max_len=N] [file or dir ...]\n\n"
+                          << "Replays every input, then runs N random mutations of them spread over\n"
+                          << "-jobs threads (0 = one per core). A failing input is saved as mismatch-*.\n";
+                return 0;
+            }
+            if (TakeOption(arg, "-runs", runs) || TakeOption(arg, "-jobs", jobs) || TakeOption(arg, "-workers", jobs) ||
+                TakeOption(arg, "-seed", seed) || TakeOption(arg, "-max_len", maxLength)) {
+                continue;
+            }
+            if (!arg.empty() && arg[0] == '-') throw std::runtime_error("Unknown option " + arg);
+            LoadInputs(arg, seeds);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    for (const Input& input : seeds) LLVMFuzzerTestOneInput(input.data(), input.size());
+    std::cout << "Replayed " << seeds.size() << " inputs\n";
+    if (runs == 0) return 0;
+
+    unsigned threads = speccybasic::ResolveThreadCount(static_cast<unsigned>(jobs), runs);
+    std::atomic<unsigned long long> done{ 0 };
+
+    // Each worker mutates its own copy of a seed for a while before picking a fresh one, so
+    // mutations can build on each other
+    speccybasic::RunWorkStealing(threads, threads, [&](size_t job, unsigned) {
+        std::mt19937_64 random(seed + job);
+        unsigned long long share = runs / threads + (job < runs % threads ? 1 : 0);
+        Input current;
+        for (unsigned long long run = 0; run < share; run++) {
+            if (run % 64 == 0) current = seeds.empty() ? Input() : seeds[random() % seeds.size()];
+            Mutate(current, seeds, random, static_cast<size_t>(maxLength));
+            LLVMFuzzerTestOneInput(current.data(), current.size());
+        }
+        done += share;
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Done " << done << " runs on " << threads << " threads in " << seconds << " s, no differences\n";
+    return 0;
+}
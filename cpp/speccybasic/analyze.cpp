@@ -0,0 +1,132 @@
+#include "analyze.h"
+#include "bas2txt.h"
+#include "tokens.h"
+#include <algorithm>
+#include <cctype>
+
+namespace speccybasic {
+
+    void ProgramAnalysis::Add(const ProgramAnalysis& other) {
+        Bytes.Add(other.Bytes);
+        for (size_t token = 0; token < TokenCounts.size(); token++) TokenCounts[token] += other.TokenCounts[token];
+        Literals += other.Literals;
+        ValStrings.Add(other.ValStrings);
+        IntExpressions.Add(other.IntExpressions);
+        PiIdioms.Add(other.PiIdioms);
+        Best.Add(other.Best);
+    }
+
+    static bool IsNumberChar(uint8_t c) {
+        return std::isdigit(c) || c == '.';
+    }
+
+    size_t DecimalLiteralLength(const uint8_t* data, size_t start, size_t end) {
+        size_t j = end;
+        while (j > start) {
+            uint8_t c = data[j - 1];
+            if (IsNumberChar(c)) {
+                j--;
+            } else if ((c == 'e' || c == 'E') && j - 1 > start && IsNumberChar(data[j - 2])) {
+                j--;
+            } else if ((c == '+' || c == '-') && j - 2 > start && (data[j - 2] == 'e' || data[j - 2] == 'E') &&
+                       IsNumberChar(data[j - 3])) {
+                j -= 2;
+            } else {
+                break;
+            }
+        }
+        if (j == end || !IsNumberChar(data[j])) return 0;
+        if (j > start) {
+            uint8_t before = data[j - 1];
+            if (std::isalnum(before) || before == '_' || before == '$' || before == '@' || before == 0xC4) return 0; // 0xC4 = BIN
+        }
+        return end - j;
+    }
+
+    // What rewriting one literal, of textLength characters, could save given its packed form
+    static void EstimateSavings(ProgramAnalysis& analysis, size_t textLength, const uint8_t* packed) {
+        analysis.Literals++;
+        uint64_t best = 3;
+        analysis.ValStrings.Add(3); // VAL and two quotes in place of the six payload bytes
+
+        // Whole numbers up to 65535 are packed as 0, sign, low, high, 0
+        bool whole = packed[0] == 0x00 && packed[1] == 0x00 && packed[4] == 0x00;
+        if (whole) {
+            analysis.IntExpressions.Add(5); // '%' in place of the payload
+            best = 5;
+            int value = packed[2] | (packed[3] << 8);
+            if (value == 0 || value == 1) {
+                uint64_t saved = textLength + 6 - 2; // Two tokens in place of the text and payload
+                analysis.PiIdioms.Add(saved);
+                best = std::max(best, saved);
+            }
+        }
+        analysis.Best.Add(best);
+    }
+
+    // Splits one line's data (up to and including its 0x0D) as DecodeLineData walks it
+    static void AnalyzeLine(const uint8_t* data, size_t length, ProgramAnalysis& analysis, ByteBreakdown& bytes) {
+        bool inString = false;
+        bool inComment = false;
+        int lastNonWhitespace = -1;
+        size_t payloadEnd = 0; // A literal's text never reaches back into the payload before it
+
+        for (size_t i = 0; i < length; i++) {
+            uint8_t c = data[i];
+            if (c == 0x0D) {
+                bytes.Overhead += length - i; // Anything past the terminator is never listed either
+                break;
+            }
+
+            if (inComment) {
+                bytes.Rems++;
+            } else if (inString) {
+                bytes.Strings++;
+            } else if (c == ';' && (lastNonWhitespace == -1 || lastNonWhitespace == ':')) {
+                inComment = true;
+                bytes.Rems++;
+            } else if (TokenAttributes[c] & IsToken) {
+                bytes.Tokens++;
+                analysis.TokenCounts[c]++;
+                if (TokenAttributes[c] & RestOfLine) inComment = true;
+            } else if (c == 0x0E) {
+                size_t payload = std::min<size_t>(6, length - i);
+                bytes.Numbers += payload;
+                if (payload == 6) {
+                    size_t textLength = DecimalLiteralLength(data, payloadEnd, i);
+                    if (textLength > 0) EstimateSavings(analysis, textLength, data + i + 1);
+                }
+                i += payload - 1;
+                payloadEnd = i + 1;
+                lastNonWhitespace = 0x0E;
+                continue;
+            } else if (c == '"') {
+                bytes.Strings++;
+            } else if (c == ' ') {
+                bytes.Spaces++;
+            } else {
+                bytes.Other++;
+            }
+
+            if (c == '"') inString = !inString;
+            if (c != ' ') lastNonWhitespace = c;
+        }
+    }
+
+    ProgramAnalysis AnalyzeProgram(const uint8_t* data, size_t size, Diagnostics* diagnostics) {
+        Diagnostics local;
+        bas2txt::LineIndex index = bas2txt::BasParser().BuildIndex(data, size, diagnostics ? diagnostics : &local);
+
+        ProgramAnalysis analysis;
+        analysis.Lines.reserve(index.Lines.size());
+        for (const bas2txt::LineIndex::Line& line : index.Lines) {
+            LineSize lineSize{ line.Number, {} };
+            lineSize.Bytes.Overhead = 4;
+            AnalyzeLine(data + line.Offset, line.Length, analysis, lineSize.Bytes);
+            analysis.Bytes.Add(lineSize.Bytes);
+            analysis.Lines.push_back(lineSize);
+        }
+        return analysis;
+    }
+
+} // namespace speccybasic
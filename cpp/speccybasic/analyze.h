@@ -0,0 +1,86 @@
+#ifndef SPECCYBASIC_ANALYZE_H
+#define SPECCYBASIC_ANALYZE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "diagnostics.h"
+
+namespace speccybasic {
+
+    // Where a program's bytes go. Every byte is in exactly one place, read the way bas2txt reads it.
+    struct ByteBreakdown {
+        uint64_t Overhead = 0; // The 4-byte line headers and each line's closing 0x0D
+        uint64_t Tokens = 0;
+        uint64_t Strings = 0;  // Quoted text, quotes included
+        uint64_t Rems = 0;     // Everything after REM or a ; comment
+        uint64_t Numbers = 0;  // The hidden 0x0E + 5-byte payloads
+        uint64_t Spaces = 0;   // Outside strings and REMs
+        uint64_t Other = 0;    // Names, digits and punctuation
+
+        uint64_t Total() const { return Overhead + Tokens + Strings + Rems + Numbers + Spaces + Other; }
+
+        void Add(const ByteBreakdown& other) {
+            Overhead += other.Overhead;
+            Tokens += other.Tokens;
+            Strings += other.Strings;
+            Rems += other.Rems;
+            Numbers += other.Numbers;
+            Spaces += other.Spaces;
+            Other += other.Other;
+        }
+    };
+
+    struct LineSize {
+        int Number;
+        ByteBreakdown Bytes;
+    };
+
+    // How many literals a rewrite applies to and the bytes it would save on them
+    struct Saving {
+        uint64_t Count = 0;
+        uint64_t Bytes = 0;
+
+        void Add(uint64_t bytes) {
+            Count++;
+            Bytes += bytes;
+        }
+
+        void Add(const Saving& other) {
+            Count += other.Count;
+            Bytes += other.Bytes;
+        }
+    };
+
+    struct ProgramAnalysis {
+        ByteBreakdown Bytes;
+        std::vector<LineSize> Lines;            // By line number
+        std::array<uint64_t, 256> TokenCounts{}; // By token byte; each costs one byte
+
+        // Payloads behind a decimal literal. The rest pad DEF FN arguments or follow BIN, $hex and
+        // @binary literals, which the rewrites below would change the meaning of.
+        uint64_t Literals = 0;
+        // Estimates for rewriting those literals, each on its own; Best takes the largest for each
+        Saving ValStrings;     // n as VAL "n": the digits move into a string and the payload goes
+        Saving IntExpressions; // A whole number 0-65535 as %n, NextBASIC only
+        Saving PiIdioms;       // 0 as NOT PI and 1 as SGN PI
+        Saving Best;
+
+        // Folds another program into a total; its lines are not copied
+        void Add(const ProgramAnalysis& other);
+    };
+
+    // Length of the decimal literal whose text runs up to the 0x0E at data[end], looking no further back
+    // than data[start]; 0 when the payload there belongs to something else: a DEF FN argument, or a
+    // BIN, $hex or @binary literal
+    size_t DecimalLiteralLength(const uint8_t* data, size_t start, size_t end);
+
+    // Measures a program in any container bas2txt reads. A line numbered above 9999 ends the program,
+    // and is recorded in diagnostics when given one.
+    ProgramAnalysis AnalyzeProgram(const uint8_t* data, size_t size, Diagnostics* diagnostics = nullptr);
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_ANALYZE_H
\ No newline at end of file
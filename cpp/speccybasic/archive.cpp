@@ -0,0 +1,518 @@
+#include "archive.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifdef SPECCYBASIC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace speccybasic {
+
+    static const uint32_t ZipLocalSignature = 0x04034b50;
+    static const uint32_t ZipCentralSignature = 0x02014b50;
+    static const uint32_t ZipEndSignature = 0x06054b50;
+    static const size_t ZipLocalSize = 30;
+    static const size_t ZipCentralSize = 46;
+    static const size_t ZipEndSize = 22;
+    static const uint16_t ZipStored = 0;
+    static const uint16_t ZipDeflated = 8;
+    static const uint16_t ZipEncrypted = 0x0001;
+    static const uint16_t ZipUtf8 = 0x0800;
+    static const size_t TarBlock = 512;
+
+    static uint16_t Read16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+    static uint32_t Read32(const uint8_t* p) { return Read16(p) | (static_cast<uint32_t>(Read16(p + 2)) << 16); }
+
+    static void Put16(std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    static void Put32(std::vector<uint8_t>& out, uint32_t value) {
+        Put16(out, value & 0xFFFF);
+        Put16(out, value >> 16);
+    }
+
+    static uint32_t Crc32(const uint8_t* data, size_t size) {
+#ifdef SPECCYBASIC_HAVE_ZLIB
+        uLong crc = crc32(0L, Z_NULL, 0);
+        while (size > 0) {
+            uInt chunk = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+            crc = crc32(crc, data, chunk);
+            data += chunk;
+            size -= chunk;
+        }
+        return static_cast<uint32_t>(crc);
+#else
+        static const auto table = [] {
+            std::vector<uint32_t> entries(256);
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[n] = c;
+            }
+            return entries;
+        }();
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t n = 0; n < size; n++) crc = table[(crc ^ data[n]) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+#endif
+    }
+
+    // Civil date conversions (proleptic Gregorian) so timestamps survive ZIP <-> TAR without the C
+    // library's time zone handling; DOS times are kept as if they were UTC
+    static int64_t DaysFromCivil(int64_t year, unsigned month, unsigned day) {
+        year -= month <= 2;
+        int64_t era = (year >= 0 ? year : year - 399) / 400;
+        unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+        unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+    }
+
+    static void CivilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+        days += 719468;
+        int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+        unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        unsigned mp = (5 * dayOfYear + 2) / 153;
+        day = dayOfYear - (153 * mp + 2) / 5 + 1;
+        month = mp < 10 ? mp + 3 : mp - 9;
+        year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+    }
+
+    static int64_t FromDosTime(uint16_t time, uint16_t date) {
+        unsigned month = std::max(1u, std::min(12u, (date >> 5) & 0x0Fu));
+        unsigned day = std::max(1u, date & 0x1Fu);
+        int64_t days = DaysFromCivil(1980 + (date >> 9), month, day);
+        return days * 86400 + (time >> 11) * 3600 + ((time >> 5) & 0x3F) * 60 + (time & 0x1F) * 2;
+    }
+
+    static void ToDosTime(int64_t seconds, uint16_t& time, uint16_t& date) {
+        if (seconds < 315532800) seconds = 315532800; // DOS dates start in 1980
+        int64_t days = seconds / 86400;
+        int64_t secondsOfDay = seconds % 86400;
+        int64_t year;
+        unsigned month, day;
+        CivilFromDays(days, year, month, day);
+        if (year > 2107) {
+            year = 2107;
+            month = 12;
+            day = 31;
+        }
+        date = static_cast<uint16_t>(((year - 1980) << 9) | (month << 5) | day);
+        time = static_cast<uint16_t>(((secondsOfDay / 3600) << 11) | (((secondsOfDay / 60) % 60) << 5) | ((secondsOfDay % 60) / 2));
+    }
+
+    ArchiveFormat ArchiveFormatFor(const std::string& path) {
+        std::string extension = MemberExtension(path);
+        if (extension == ".zip") return ArchiveFormat::Zip;
+        if (extension == ".tar") return ArchiveFormat::Tar;
+        throw std::runtime_error("Unknown archive type for " + path + " (expected .zip or .tar)");
+    }
+
+    bool IsArchivePath(const std::string& path) {
+        std::string extension = MemberExtension(path);
+        if (extension == ".zip" || extension == ".tar" || extension == ".tgz") return true;
+        return extension == ".gz" && MemberExtension(path.substr(0, path.size() - 3)) == ".tar";
+    }
+
+    std::string MemberExtension(const std::string& name) {
+        size_t slash = name.find_last_of("/\\");
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot + 1 == name.size()) return std::string();
+        std::string extension = name.substr(dot);
+        for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return extension;
+    }
+
+    std::string ReplaceMemberExtension(const std::string& name, const std::string& extension) {
+        std::string current = MemberExtension(name);
+        return name.substr(0, name.size() - current.size()) + extension;
+    }
+
+    std::string MemberStem(const std::string& name) {
+        size_t slash = name.find_last_of("/\\");
+        std::string file = (slash == std::string::npos) ? name : name.substr(slash + 1);
+        return file.substr(0, file.size() - MemberExtension(file).size());
+    }
+
+#ifdef SPECCYBASIC_HAVE_ZLIB
+    // windowBits picks the framing: negative for raw deflate (ZIP), 16 + 15 for gzip
+    static void Inflate(const uint8_t* data, size_t size, int windowBits, std::vector<uint8_t>& out, size_t expected) {
+        z_stream stream{};
+        if (inflateInit2(&stream, windowBits) != Z_OK) throw std::runtime_error("Could not start inflating");
+        // Deflate expands at most about 1032:1, so a damaged size field can't demand more than that
+        out.resize(std::max<size_t>(std::min(expected, size * 1032), 1024));
+
+        int status = Z_OK;
+        size_t produced = 0;
+        while (status != Z_STREAM_END) {
+            if (produced == out.size()) out.resize(out.size() * 2);
+            uInt inChunk = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+            stream.next_in = const_cast<Bytef*>(data);
+            stream.avail_in = inChunk;
+            stream.next_out = out.data() + produced;
+            stream.avail_out = static_cast<uInt>(std::min<size_t>(out.size() - produced, 1u << 30));
+            status = inflate(&stream, Z_NO_FLUSH);
+            size_t used = inChunk - stream.avail_in;
+            data += used;
+            size -= used;
+            produced = static_cast<size_t>(stream.next_out - out.data());
+            if (status == Z_BUF_ERROR && size == 0) status = Z_DATA_ERROR;
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                inflateEnd(&stream);
+                throw std::runtime_error("Damaged compressed data");
+            }
+        }
+        inflateEnd(&stream);
+        out.resize(produced);
+    }
+#endif
+
+    ArchiveReader::ArchiveReader(const uint8_t* data, size_t size) : _data(data), _size(size) {
+        if (size >= 2 && data[0] == 0x1F && data[1] == 0x8B) {
+#ifdef SPECCYBASIC_HAVE_ZLIB
+            // Tar has no index, so a gzipped one is inflated once and then read like any other
+            Inflate(data, size, 16 + MAX_WBITS, _unpacked, size * 4);
+            _data = _unpacked.data();
+            _size = _unpacked.size();
+            ReadTar();
+            return;
+#else
+            throw std::runtime_error("Gzipped archives need a build with zlib");
+#endif
+        }
+        if (size >= 4 && (Read32(data) == ZipLocalSignature || Read32(data) == ZipEndSignature)) {
+            ReadZip();
+        } else if (size >= TarBlock && std::memcmp(data + 257, "ustar", 5) == 0) {
+            ReadTar();
+        } else {
+            throw std::runtime_error("Not a ZIP or TAR archive");
+        }
+    }
+
+    void ArchiveReader::ReadZip() {
+        // The end record is the last thing in the file, followed only by a comment of up to 64K
+        if (_size < ZipEndSize) throw std::runtime_error("Truncated ZIP archive");
+        size_t end = _size - ZipEndSize;
+        size_t lowest = (end > 0xFFFF) ? end - 0xFFFF : 0;
+        while (Read32(_data + end) != ZipEndSignature) {
+            if (end == lowest) throw std::runtime_error("ZIP archive has no central directory");
+            end--;
+        }
+
+        size_t count = Read16(_data + end + 10);
+        size_t directorySize = Read32(_data + end + 12);
+        size_t position = Read32(_data + end + 16);
+        if (count == 0xFFFF || position == 0xFFFFFFFF) throw std::runtime_error("ZIP64 archives are not supported");
+        if (position + directorySize > end) throw std::runtime_error("Damaged ZIP central directory");
+
+        for (size_t n = 0; n < count; n++) {
+            if (position + ZipCentralSize > end || Read32(_data + position) != ZipCentralSignature) {
+                throw std::runtime_error("Damaged ZIP central directory");
+            }
+            const uint8_t* record = _data + position;
+            size_t nameLength = Read16(record + 28);
+            size_t skip = ZipCentralSize + nameLength + Read16(record + 30) + Read16(record + 32);
+            if (position + skip > end) throw std::runtime_error("Damaged ZIP central directory");
+
+            ArchiveEntry entry;
+            entry.Name.assign(reinterpret_cast<const char*>(record + ZipCentralSize), nameLength);
+            entry.Flags = Read16(record + 8);
+            entry.Method = Read16(record + 10);
+            entry.ModifiedTime = FromDosTime(Read16(record + 12), Read16(record + 14));
+            entry.Crc = Read32(record + 16);
+            entry.HasChecksum = true;
+            entry.StoredSize = Read32(record + 20);
+            entry.Size = Read32(record + 24);
+            size_t local = Read32(record + 42);
+            position += skip;
+
+            if (entry.Name.empty() || entry.Name.back() == '/') continue; // Directory
+            if (entry.StoredSize == 0xFFFFFFFF || entry.Size == 0xFFFFFFFF || local == 0xFFFFFFFF) {
+                throw std::runtime_error("ZIP64 archives are not supported");
+            }
+
+            // The local header repeats the name but may carry a different extra field
+            if (local + ZipLocalSize > _size || Read32(_data + local) != ZipLocalSignature) {
+                throw std::runtime_error("Damaged ZIP entry " + entry.Name);
+            }
+            entry.Offset = local + ZipLocalSize + Read16(_data + local + 26) + Read16(_data + local + 28);
+            if (entry.Offset > _size || entry.StoredSize > _size - entry.Offset) {
+                throw std::runtime_error("Truncated ZIP entry " + entry.Name);
+            }
+            _entries.push_back(std::move(entry));
+        }
+    }
+
+    static size_t ParseOctal(const uint8_t* field, size_t length) {
+        size_t value = 0;
+        size_t n = 0;
+        while (n < length && field[n] == ' ') n++;
+        for (; n < length && field[n] >= '0' && field[n] <= '7'; n++) value = value * 8 + (field[n] - '0');
+        return value;
+    }
+
+    static std::string Field(const uint8_t* field, size_t length) {
+        const uint8_t* stop = static_cast<const uint8_t*>(std::memchr(field, 0, length));
+        return std::string(reinterpret_cast<const char*>(field), stop ? static_cast<size_t>(stop - field) : length);
+    }
+
+    void ArchiveReader::ReadTar() {
+        std::string longName; // From a preceding GNU 'L' or pax 'x' header
+        size_t position = 0;
+        while (position + TarBlock <= _size) {
+            const uint8_t* header = _data + position;
+            if (std::all_of(header, header + TarBlock, [](uint8_t b) { return b == 0; })) break; // End blocks
+
+            size_t sum = 0;
+            for (size_t n = 0; n < TarBlock; n++) sum += (n >= 148 && n < 156) ? ' ' : header[n];
+            if (sum != ParseOctal(header + 148, 8)) throw std::runtime_error("Damaged TAR header");
+
+            size_t size = ParseOctal(header + 124, 12);
+            size_t data = position + TarBlock;
+            if (size > _size - data) throw std::runtime_error("Truncated TAR archive");
+            position = data + (size + TarBlock - 1) / TarBlock * TarBlock;
+
+            char type = static_cast<char>(header[156]);
+            if (type == 'L') {
+                longName = Field(_data + data, size);
+                continue;
+            }
+            if (type == 'x') {
+                // Records are "<length> <key>=<value>\n"; only the path matters here
+                std::string records(reinterpret_cast<const char*>(_data + data), size);
+                size_t at = 0;
+                while (at < records.size()) {
+                    size_t space = records.find(' ', at);
+                    size_t length = (space == std::string::npos) ? 0 : std::strtoul(records.c_str() + at, nullptr, 10);
+                    if (length == 0 || at + length > records.size()) break;
+                    std::string record = records.substr(space + 1, at + length - space - 2);
+                    if (record.rfind("path=", 0) == 0) longName = record.substr(5);
+                    at += length;
+                }
+                continue;
+            }
+
+            std::string name = longName;
+            longName.clear();
+            if (type != '0' && type != '\0' && type != '7') continue; // Directories, links, global headers
+            if (name.empty()) {
+                name = Field(header, 100);
+                std::string prefix = (std::memcmp(header + 257, "ustar", 5) == 0) ? Field(header + 345, 155) : std::string();
+                if (!prefix.empty()) name = prefix + "/" + name;
+            }
+
+            ArchiveEntry entry;
+            entry.Name = name;
+            entry.Offset = data;
+            entry.StoredSize = size;
+            entry.Size = size;
+            entry.ModifiedTime = static_cast<int64_t>(ParseOctal(header + 136, 12));
+            _entries.push_back(std::move(entry));
+        }
+    }
+
+    std::vector<uint8_t> ArchiveReader::Extract(const ArchiveEntry& entry) const {
+        const uint8_t* data = _data + entry.Offset;
+        if (entry.Flags & ZipEncrypted) throw std::runtime_error("Encrypted members are not supported");
+
+        std::vector<uint8_t> out;
+        if (entry.Method == ZipStored) {
+            out.assign(data, data + entry.StoredSize);
+        } else if (entry.Method == ZipDeflated) {
+#ifdef SPECCYBASIC_HAVE_ZLIB
+            Inflate(data, entry.StoredSize, -MAX_WBITS, out, entry.Size);
+#else
+            throw std::runtime_error("Deflated members need a build with zlib");
+#endif
+        } else {
+            throw std::runtime_error("Unsupported compression method " + std::to_string(entry.Method));
+        }
+
+        if (entry.HasChecksum) {
+            if (out.size() != entry.Size || Crc32(out.data(), out.size()) != entry.Crc) {
+                throw std::runtime_error("Checksum mismatch in " + entry.Name);
+            }
+        }
+        return out;
+    }
+
+    PackedMember PackMember(ArchiveFormat format, const std::string& name, const std::vector<uint8_t>& data, int64_t modifiedTime) {
+        PackedMember member;
+        member.Name = name;
+        member.Size = data.size();
+        member.ModifiedTime = modifiedTime;
+        if (format == ArchiveFormat::Tar) {
+            member.Payload = data;
+            return member;
+        }
+
+        member.Crc = Crc32(data.data(), data.size());
+#ifdef SPECCYBASIC_HAVE_ZLIB
+        z_stream stream{};
+        if (data.size() < (1u << 30) && deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+            member.Payload.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+            stream.next_in = const_cast<Bytef*>(data.data());
+            stream.avail_in = static_cast<uInt>(data.size());
+            stream.next_out = member.Payload.data();
+            stream.avail_out = static_cast<uInt>(member.Payload.size());
+            bool done = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+            member.Payload.resize(stream.total_out);
+            deflateEnd(&stream);
+            // Tiny programs can grow when deflated; those are stored
+            if (done && member.Payload.size() < data.size()) {
+                member.Method = ZipDeflated;
+                return member;
+            }
+        }
+#endif
+        member.Method = ZipStored;
+        member.Payload = data;
+        return member;
+    }
+
+    ArchiveWriter::ArchiveWriter(const std::string& path, ArchiveFormat format) : _path(path), _format(format) {
+        _file = std::fopen(path.c_str(), "wb");
+        if (!_file) throw std::runtime_error("Could not open output archive " + path);
+    }
+
+    ArchiveWriter::~ArchiveWriter() {
+        if (_file) std::fclose(_file);
+    }
+
+    void ArchiveWriter::Write(const void* data, size_t size) {
+        if (size > 0 && std::fwrite(data, 1, size, _file) != size) throw std::runtime_error("Could not write output archive " + _path);
+        _written += size;
+    }
+
+    static bool IsAscii(const std::string& text) {
+        return std::all_of(text.begin(), text.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; });
+    }
+
+    static void PutOctal(uint8_t* field, size_t length, uint64_t value) {
+        // length - 1 digits and a NUL
+        field[length - 1] = 0;
+        for (size_t n = length - 1; n-- > 0; value >>= 3) field[n] = static_cast<uint8_t>('0' + (value & 7));
+    }
+
+    void ArchiveWriter::Add(const PackedMember& member) {
+        if (_format == ArchiveFormat::Tar) {
+            uint8_t header[TarBlock] = {};
+            const std::string& name = member.Name;
+            std::string prefix;
+            std::string rest = name;
+            if (name.size() > 100) {
+                // ustar splits long paths at a '/' into a 155-byte prefix and a 100-byte name
+                size_t split = name.rfind('/', 155);
+                if (split == std::string::npos || name.size() - split - 1 > 100) {
+                    throw std::runtime_error("Name too long for a TAR archive: " + name);
+                }
+                prefix = name.substr(0, split);
+                rest = name.substr(split + 1);
+            }
+            if ((member.Size >> 33) != 0) throw std::runtime_error("Member too large for a TAR archive: " + name);
+
+            std::memcpy(header, rest.data(), rest.size());
+            PutOctal(header + 100, 8, 0644);
+            PutOctal(header + 108, 8, 0);
+            PutOctal(header + 116, 8, 0);
+            PutOctal(header + 124, 12, member.Size);
+            PutOctal(header + 136, 12, static_cast<uint64_t>(std::max<int64_t>(member.ModifiedTime, 0)));
+            header[156] = '0';
+            std::memcpy(header + 257, "ustar", 6);
+            std::memcpy(header + 263, "00", 2);
+            std::memcpy(header + 345, prefix.data(), prefix.size());
+
+            std::memset(header + 148, ' ', 8);
+            size_t sum = 0;
+            for (uint8_t b : header) sum += b;
+            PutOctal(header + 148, 7, sum);
+
+            static const uint8_t padding[TarBlock] = {};
+            Write(header, TarBlock);
+            Write(member.Payload.data(), member.Payload.size());
+            Write(padding, (TarBlock - member.Payload.size() % TarBlock) % TarBlock);
+            return;
+        }
+
+        if (_written > 0xFFFFFFFFu || member.Payload.size() > 0xFFFFFFFFu || member.Size > 0xFFFFFFFFu ||
+            member.Name.size() > 0xFFFF || _central.size() == 0xFFFF) {
+            throw std::runtime_error("Output too large for a ZIP archive without ZIP64");
+        }
+
+        uint16_t time, date;
+        ToDosTime(member.ModifiedTime, time, date);
+        std::vector<uint8_t> header;
+        Put32(header, ZipLocalSignature);
+        Put16(header, 20);
+        Put16(header, IsAscii(member.Name) ? 0 : ZipUtf8);
+        Put16(header, member.Method);
+        Put16(header, time);
+        Put16(header, date);
+        Put32(header, member.Crc);
+        Put32(header, static_cast<uint32_t>(member.Payload.size()));
+        Put32(header, static_cast<uint32_t>(member.Size));
+        Put16(header, static_cast<uint32_t>(member.Name.size()));
+        Put16(header, 0);
+        header.insert(header.end(), member.Name.begin(), member.Name.end());
+
+        _central.push_back({member.Name, _written, member.Payload.size(), member.Size, member.Method, member.Crc, member.ModifiedTime});
+        Write(header.data(), header.size());
+        Write(member.Payload.data(), member.Payload.size());
+    }
+
+    void ArchiveWriter::Finish() {
+        if (_format == ArchiveFormat::Tar) {
+            static const uint8_t end[TarBlock * 2] = {};
+            Write(end, sizeof(end));
+        } else {
+            size_t start = _written;
+            std::vector<uint8_t> directory;
+            for (const CentralEntry& entry : _central) {
+                uint16_t time, date;
+                ToDosTime(entry.ModifiedTime, time, date);
+                Put32(directory, ZipCentralSignature);
+                Put16(directory, 20);
+                Put16(directory, 20);
+                Put16(directory, IsAscii(entry.Name) ? 0 : ZipUtf8);
+                Put16(directory, entry.Method);
+                Put16(directory, time);
+                Put16(directory, date);
+                Put32(directory, entry.Crc);
+                Put32(directory, static_cast<uint32_t>(entry.StoredSize));
+                Put32(directory, static_cast<uint32_t>(entry.Size));
+                Put16(directory, static_cast<uint32_t>(entry.Name.size()));
+                Put16(directory, 0); // Extra field
+                Put16(directory, 0); // Comment
+                Put16(directory, 0); // Disk
+                Put16(directory, 0); // Internal attributes
+                Put32(directory, 0); // External attributes
+                Put32(directory, static_cast<uint32_t>(entry.Offset));
+                directory.insert(directory.end(), entry.Name.begin(), entry.Name.end());
+            }
+            size_t directorySize = directory.size();
+            if (start > 0xFFFFFFFFu || directorySize > 0xFFFFFFFFu) {
+                throw std::runtime_error("Output too large for a ZIP archive without ZIP64");
+            }
+
+            Put32(directory, ZipEndSignature);
+            Put16(directory, 0);
+            Put16(directory, 0);
+            Put16(directory, static_cast<uint32_t>(_central.size()));
+            Put16(directory, static_cast<uint32_t>(_central.size()));
+            Put32(directory, static_cast<uint32_t>(directorySize));
+            Put32(directory, static_cast<uint32_t>(start));
+            Put16(directory, 0);
+            Write(directory.data(), directory.size());
+        }
+
+        std::FILE* file = _file;
+        _file = nullptr;
+        if (std::fclose(file) != 0) throw std::runtime_error("Could not write output archive " + _path);
+    }
+
+} // namespace speccybasic
@@ -0,0 +1,228 @@
+#ifndef SPECCYBASIC_ARCHIVE_H
+#define SPECCYBASIC_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "batch.h"
+#include "mappedfile.h"
+
+// --archive support for the CLIs: every program in a ZIP or TAR converted in memory into another one.
+// ZIP members may be stored or deflated; deflate needs zlib (SPECCYBASIC_HAVE_ZLIB), as do .tar.gz inputs.
+namespace speccybasic {
+
+    enum class ArchiveFormat { Zip, Tar };
+
+    // From the output's extension, .zip or .tar
+    ArchiveFormat ArchiveFormatFor(const std::string& path);
+
+    struct ArchiveEntry {
+        std::string Name;       // Path inside the archive, '/' separated
+        size_t Offset = 0;      // Start of the member's (possibly compressed) data
+        size_t StoredSize = 0;
+        size_t Size = 0;
+        uint16_t Method = 0;    // ZIP compression method; 0 = stored
+        uint16_t Flags = 0;     // ZIP general purpose flags
+        uint32_t Crc = 0;
+        bool HasChecksum = false; // ZIP members carry a CRC-32, TAR members don't
+        int64_t ModifiedTime = 0; // Unix seconds
+    };
+
+    // Lists the regular files of an archive image without copying it. Members are decompressed on
+    // demand by Extract, which may be called from any number of threads at once.
+    class ArchiveReader {
+    private:
+        const uint8_t* _data;
+        size_t _size;
+        std::vector<uint8_t> _unpacked; // A .tar.gz inflated in full
+        std::vector<ArchiveEntry> _entries;
+
+        void ReadZip();
+        void ReadTar();
+
+    public:
+        // Throws std::runtime_error when the image is not a ZIP or (optionally gzipped) TAR
+        ArchiveReader(const uint8_t* data, size_t size);
+
+        const std::vector<ArchiveEntry>& Entries() const { return _entries; }
+        std::vector<uint8_t> Extract(const ArchiveEntry& entry) const;
+    };
+
+    // A converted member, already compressed and checksummed so the writer only copies bytes
+    struct PackedMember {
+        std::string Name;
+        std::vector<uint8_t> Payload;
+        size_t Size = 0;
+        uint16_t Method = 0;
+        uint32_t Crc = 0;
+        int64_t ModifiedTime = 0;
+    };
+
+    PackedMember PackMember(ArchiveFormat format, const std::string& name, const std::vector<uint8_t>& data, int64_t modifiedTime);
+
+    // Appends packed members to a new archive file; Finish writes the ZIP central directory or the
+    // TAR end blocks and closes it
+    class ArchiveWriter {
+    private:
+        struct CentralEntry {
+            std::string Name;
+            size_t Offset;
+            size_t StoredSize;
+            size_t Size;
+            uint16_t Method;
+            uint32_t Crc;
+            int64_t ModifiedTime;
+        };
+
+        std::string _path;
+        ArchiveFormat _format;
+        std::FILE* _file;
+        size_t _written = 0;
+        std::vector<CentralEntry> _central;
+
+        void Write(const void* data, size_t size);
+
+    public:
+        ArchiveWriter(const std::string& path, ArchiveFormat format);
+        ~ArchiveWriter();
+
+        void Add(const PackedMember& member);
+        void Finish();
+
+        ArchiveWriter(const ArchiveWriter&) = delete;
+        ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+    };
+
+    // Names that --analyze opens as archives: .zip, .tar, .tar.gz and .tgz
+    bool IsArchivePath(const std::string& path);
+
+    // The extension of a member name, lowercased and with its dot, or empty
+    std::string MemberExtension(const std::string& name);
+    std::string ReplaceMemberExtension(const std::string& name, const std::string& extension);
+    // The file name without directories or extension, e.g. for a tape header
+    std::string MemberStem(const std::string& name);
+
+    struct ArchiveOptions {
+        std::string Input;
+        std::string Output;
+        unsigned Threads = 1;
+    };
+
+    // --archive <in> <out> with an optional -j N; false when args hold no --archive
+    inline bool ParseArchiveArguments(const std::vector<std::string>& args, ArchiveOptions& options) {
+        size_t at = 0;
+        while (at < args.size() && args[at] != "--archive") at++;
+        if (at == args.size()) return false;
+        if (at + 2 >= args.size()) throw std::runtime_error("--archive expects <input-archive> <output-archive>");
+        options.Input = args[at + 1];
+        options.Output = args[at + 2];
+
+        std::vector<std::string> rest(args.begin(), args.begin() + at);
+        rest.insert(rest.end(), args.begin() + at + 3, args.end());
+        BatchOptions batch = ParseBatchArguments(rest, std::string());
+        if (!batch.Jobs.empty()) throw std::runtime_error("--archive cannot be combined with other batch options");
+        options.Threads = batch.Threads;
+        return true;
+    }
+
+    // Converts every member of the input archive that rename(name) gives a new name to, on `threads`
+    // workers, and writes the results to the output archive in the input's order. convert(job, input,
+    // output, warnings) fills output from the member's bytes and returns the message for the report; it
+    // must be safe to call concurrently. Members that fail are reported and left out of the output.
+    template <typename Rename, typename Convert>
+    std::vector<BatchResult> ConvertArchive(const ArchiveOptions& options, Rename rename, Convert convert) {
+        namespace fs = std::filesystem;
+        std::error_code ignored;
+        if (fs::equivalent(options.Input, options.Output, ignored)) {
+            throw std::runtime_error("The output archive must not be the input archive");
+        }
+        ArchiveFormat format = ArchiveFormatFor(options.Output);
+
+        MappedFile file;
+        if (!file.Open(options.Input)) throw std::runtime_error("Could not open archive " + options.Input);
+        ArchiveReader reader(file.Data(), file.Size());
+
+        std::vector<const ArchiveEntry*> members;
+        std::vector<BatchJob> jobs;
+        for (const ArchiveEntry& entry : reader.Entries()) {
+            std::string output = rename(entry.Name);
+            if (output.empty()) continue;
+            members.push_back(&entry);
+            jobs.push_back({entry.Name, output});
+        }
+
+        std::vector<PackedMember> packed(jobs.size());
+        std::vector<BatchResult> results = RunBatch(jobs, options.Threads, [&](const BatchJob& job, Diagnostics& warnings) {
+            size_t index = &job - jobs.data();
+            std::vector<uint8_t> input = reader.Extract(*members[index]);
+            std::vector<uint8_t> output;
+            std::string message = convert(job, input, output, warnings);
+            packed[index] = PackMember(format, job.Output, output, members[index]->ModifiedTime);
+            return message;
+        });
+
+        ArchiveWriter writer(options.Output, format);
+        for (size_t n = 0; n < results.size(); n++) {
+            if (results[n].Success) writer.Add(packed[n]);
+        }
+        writer.Finish();
+        return results;
+    }
+
+    // What --analyze reads: files, and archives (see IsArchivePath) standing for those of their members
+    // that select(name) accepted, named "<archive>:<member>". Archives are listed up front; Read may be
+    // called for any job from any number of threads at once.
+    class InputSet {
+    private:
+        std::vector<std::unique_ptr<MappedFile>> _archives;
+        std::vector<std::unique_ptr<ArchiveReader>> _readers;
+        std::vector<BatchJob> _jobs;
+        std::vector<std::pair<const ArchiveReader*, const ArchiveEntry*>> _members; // Null for plain files
+
+    public:
+        template <typename Select>
+        InputSet(const std::vector<std::string>& inputs, Select select) {
+            for (const std::string& input : inputs) {
+                if (!IsArchivePath(input)) {
+                    _jobs.push_back({input, std::string()});
+                    _members.push_back({nullptr, nullptr});
+                    continue;
+                }
+                _archives.push_back(std::make_unique<MappedFile>());
+                if (!_archives.back()->Open(input)) throw std::runtime_error("Could not open archive " + input);
+                _readers.push_back(std::make_unique<ArchiveReader>(_archives.back()->Data(), _archives.back()->Size()));
+                for (const ArchiveEntry& entry : _readers.back()->Entries()) {
+                    if (!select(entry.Name)) continue;
+                    _jobs.push_back({input + ":" + entry.Name, std::string()});
+                    _members.push_back({_readers.back().get(), &entry});
+                }
+            }
+        }
+
+        const std::vector<BatchJob>& Jobs() const { return _jobs; }
+
+        // Hands job `index`'s bytes to use(data, size): an archive member decompressed, or a file mapped
+        template <typename Use>
+        void Read(size_t index, Use use) const {
+            const auto& member = _members[index];
+            if (member.first) {
+                std::vector<uint8_t> data = member.first->Extract(*member.second);
+                use(data.data(), data.size());
+                return;
+            }
+            MappedFile file;
+            if (!file.Open(_jobs[index].Input)) throw std::runtime_error("Could not open file: " + _jobs[index].Input);
+            use(file.Data(), file.Size());
+        }
+    };
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_ARCHIVE_H
\ No newline at end of file
@@ -0,0 +1,452 @@
+#include "bas2txt.h"
+#include "scan.h"
+#include "tokens.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <cctype>
+#include <algorithm>
+
+namespace bas2txt {
+
+    // Static helper scoped only to this compilation unit to avoid header dependencies.
+    // UTF-8 spelling of the two codes the Spectrum moves off ASCII; only called for 0x60 and 0x7F.
+    static std::string_view GetUnicodeChar(uint8_t code) {
+        return (code == 0x60) ? "£" : "©";
+    }
+
+    static void AppendNumber(std::string& out, int value) {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+    }
+
+    // Byte sources for DecodeProgram. Peek/Read hand out n contiguous bytes, or nullptr when fewer than n
+    // remain before the limit (the end of the data, or the payload length a +3DOS header announces).
+    class MemorySource {
+    private:
+        const uint8_t* _data;
+        size_t _size;
+        size_t _offset = 0;
+
+    public:
+        MemorySource(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+        const uint8_t* Peek(size_t n) const { return (n <= _size - _offset) ? _data + _offset : nullptr; }
+
+        const uint8_t* Read(size_t n) {
+            const uint8_t* bytes = Peek(n);
+            if (bytes) _offset += n;
+            return bytes;
+        }
+
+        void SetLimit(size_t limit) { if (limit < _size) _size = limit; }
+
+        size_t Consumed() const { return _offset; }
+    };
+
+    // Reads through a buffer that only ever grows to the longest line (at most 64K), so memory stays
+    // bounded however large the input stream is. Returned bytes are valid until the next call.
+    class StreamSource {
+    private:
+        std::FILE* _file;
+        std::vector<uint8_t> _buffer;
+        size_t _start = 0;
+        size_t _end = 0;
+        size_t _consumed = 0;
+        size_t _limit = SIZE_MAX;
+        bool _eof = false;
+
+    public:
+        explicit StreamSource(std::FILE* file) : _file(file), _buffer(8192) {}
+
+        const uint8_t* Peek(size_t n) {
+            if (n > _limit - _consumed) return nullptr;
+            if (_end - _start < n) {
+                std::memmove(_buffer.data(), _buffer.data() + _start, _end - _start);
+                _end -= _start;
+                _start = 0;
+                if (_buffer.size() < n) _buffer.resize(n);
+                while (_end < n && !_eof) {
+                    size_t got = std::fread(_buffer.data() + _end, 1, _buffer.size() - _end, _file);
+                    if (got == 0) {
+                        if (std::ferror(_file)) throw std::runtime_error("Could not read input stream.");
+                        _eof = true;
+                    }
+                    _end += got;
+                }
+                if (_end < n) return nullptr;
+            }
+            return _buffer.data() + _start;
+        }
+
+        const uint8_t* Read(size_t n) {
+            const uint8_t* bytes = Peek(n);
+            if (bytes) {
+                _start += n;
+                _consumed += n;
+            }
+            return bytes;
+        }
+
+        void SetLimit(size_t limit) { _limit = limit; }
+
+        size_t Consumed() const { return _consumed; }
+    };
+
+    std::string BasParser::Parse(const std::vector<uint8_t>& data) const {
+        std::string result;
+        Parse(data.data(), data.size(), result);
+        return result;
+    }
+
+    void BasParser::Parse(const uint8_t* data, size_t size, std::string& out, speccybasic::ConversionStats* stats,
+                          speccybasic::Diagnostics* diagnostics) const {
+        // Listings are rarely more than twice their tokenized size
+        out.reserve(out.size() + size * 2);
+
+        MemorySource source(data, size);
+        size_t outStart = out.size();
+        DecodeProgram(source, out, [](std::string&) {}, stats, diagnostics);
+        if (stats) stats->OutputBytes += out.size() - outStart;
+    }
+
+    void BasParser::ParseStream(std::FILE* in, std::FILE* out, speccybasic::ConversionStats* stats,
+                                speccybasic::Diagnostics* diagnostics) const {
+        StreamSource source(in);
+        std::string pending;
+
+        auto flush = [out, stats](std::string& text) {
+            speccybasic::ScopedTimer writeTimer(stats ? &stats->WriteNs : nullptr);
+            if (std::fwrite(text.data(), 1, text.size(), out) != text.size()) {
+                throw std::runtime_error("Could not write output stream.");
+            }
+            if (stats) stats->OutputBytes += text.size();
+            text.clear();
+        };
+
+        DecodeProgram(source, pending, [&](std::string& text) {
+            if (text.size() >= 65536) flush(text);
+        }, stats, diagnostics);
+        flush(pending);
+    }
+
+    static bool IsListedAutoStart(int line) {
+        return line != 0 && line != 32768 && line <= 9999;
+    }
+
+    // A tape header block (flag to checksum) for a BASIC program with an intact checksum
+    static bool IsProgramHeaderBlock(const uint8_t* block) {
+        if (block[0] != 0x00 || block[1] != 0x00) return false;
+        uint8_t sum = 0;
+        for (int i = 0; i < 19; i++) sum ^= block[i];
+        return sum == 0;
+    }
+
+    // Takes the tape header block and the data block's flag, limiting source to the program. False,
+    // with nothing consumed, when this is not a program header followed by its data block.
+    template <typename Source>
+    static bool SkipTapeBlocks(Source& source, size_t headerSkip, size_t dataSkip, int& autoStart) {
+        const uint8_t* blocks = source.Peek(headerSkip + 19 + dataSkip + 1);
+        if (!blocks || !IsProgramHeaderBlock(blocks + headerSkip)) return false;
+
+        const uint8_t* data = blocks + headerSkip + 19;
+        size_t dataLength = data[dataSkip - 2] | (data[dataSkip - 1] << 8); // Counts the flag and checksum
+        if (data[dataSkip] != 0xFF || dataLength < 2) return false;
+
+        const uint8_t* header = blocks + headerSkip;
+        int line = header[14] | (header[15] << 8);
+        if (IsListedAutoStart(line)) autoStart = line;
+
+        source.Read(headerSkip + 19 + dataSkip + 1);
+        source.SetLimit(source.Consumed() + dataLength - 2);
+        return true;
+    }
+
+    // Consumes the container (+3DOS header, or a TAP or TZX image's header blocks) and the banked "BC"
+    // marker if present. Returns whether the program is banked; autoStart is set to the line to list
+    // as #autostart, or 0 for none.
+    template <typename Source>
+    static bool SkipHeaders(Source& source, int& autoStart) {
+        autoStart = 0;
+
+        // TZX: signature and version, then the first program as two standard-speed (0x10) blocks,
+        // each with its ID, pause and length ahead of the TAP-style block
+        const uint8_t* tzx = source.Peek(10);
+        if (tzx && std::memcmp(tzx, "ZXTape!\x1A", 8) == 0) {
+            source.Read(10);
+
+            // Text description (0x30) and archive info (0x32) blocks often come first
+            while (const uint8_t* id = source.Peek(3)) {
+                size_t skip = (id[0] == 0x30) ? 2 + id[1] : (id[0] == 0x32) ? 3 + (id[1] | (id[2] << 8)) : 0;
+                if (skip == 0 || !source.Read(skip)) break;
+            }
+
+            const uint8_t* ids = source.Peek(5 + 19 + 1);
+            bool standard = ids && ids[0] == 0x10 && ids[3] == 19 && ids[4] == 0 && ids[5 + 19] == 0x10;
+            if (!standard || !SkipTapeBlocks(source, 5, 5, autoStart)) {
+                throw std::runtime_error("TZX image does not start with a BASIC program");
+            }
+        } else if (const uint8_t* tap = source.Peek(2)) {
+            // TAP: a 19-byte header block, each block behind its 2-byte length
+            if (tap[0] == 19 && tap[1] == 0) SkipTapeBlocks(source, 2, 2, autoStart);
+        }
+
+        // Handle +3DOS Header
+        if (const uint8_t* header = source.Peek(128)) {
+            std::string_view sig(reinterpret_cast<const char*>(header), 8);
+            if (sig == "PLUS3DOS" || sig.substr(0, 7) == "ZXPLUS3") {
+                uint8_t hType = header[15];
+                size_t hFileLength = header[16] | (header[17] << 8);
+
+                // Fix: JS bugs cancel out to write standard Little-Endian bytes, so we parse it as standard Little-Endian
+                int headerAutoStart = header[18] | (header[19] << 8);
+
+                size_t hOffset = header[20] | (header[21] << 8);
+
+                // Replicate logic `const length = header.hType === 0 ? header.hOffset : header.hFileLength;`
+                size_t payloadLength = (hType == 0) ? hOffset : hFileLength;
+
+                if (IsListedAutoStart(headerAutoStart)) autoStart = headerAutoStart;
+
+                source.Read(128);
+                source.SetLimit(128 + payloadLength);
+            }
+        }
+
+        // Handle banked logic
+        const uint8_t* marker = source.Peek(2);
+        if (marker && marker[0] == 0x42 && marker[1] == 0x43) {
+            source.Read(2);
+            return true;
+        }
+        return false;
+    }
+
+    // Reads the next line, returning its data (lineLen bytes, up to and including the 0x0D), or nullptr
+    // at the end of the program. A line numbered above 9999 throws, or with diagnostics ends the program.
+    template <typename Source>
+    static const uint8_t* NextLine(Source& source, bool banked, int& lineNum, size_t& lineLen, speccybasic::Diagnostics* diagnostics) {
+        const uint8_t* lineHeader = source.Read(4);
+        if (!lineHeader) return nullptr;
+
+        // In bas2txt: unpack '<n$line S$length' means BigEndian Line, LittleEndian Length
+        lineNum = (lineHeader[0] << 8) | lineHeader[1];
+        lineLen = lineHeader[2] | (lineHeader[3] << 8); // Size_t for bounds comparisons
+
+        if (lineLen == 0) return nullptr;
+
+        if (lineNum > 9999) {
+            if (lineLen == 0x8080 && lineNum == 0x8080 && banked) {
+                return nullptr;
+            }
+            std::string message = std::to_string(lineNum) + " is beyond 9999 range: " + std::to_string(lineLen);
+            if (!diagnostics) throw std::runtime_error(message);
+            diagnostics->Add(lineNum, 0, speccybasic::DiagnosticCode::LineOutOfRange,
+                             "beyond the 9999 range (length " + std::to_string(lineLen) + "); listing stopped here");
+            return nullptr;
+        }
+
+        return source.Read(lineLen);
+    }
+
+    void BasParser::DecodeLine(int lineNum, const uint8_t* lineData, size_t lineLen, std::string& out,
+                               speccybasic::ConversionStats* stats) const {
+        // Decode straight behind the line number
+        size_t lineStart = out.size();
+        AppendNumber(out, lineNum);
+        out += ' ';
+        if (stats) {
+            DecodeLineData<true>(lineData, 0, lineLen, out, stats);
+            stats->Lines++;
+        } else {
+            DecodeLineData<false>(lineData, 0, lineLen, out, nullptr);
+        }
+
+        // Trim trailing spaces mimicking JS `lines.push(string.trim());`
+        while (out.size() > lineStart && std::isspace(static_cast<unsigned char>(out.back()))) {
+            out.pop_back();
+        }
+    }
+
+    template <typename Source, typename Flush>
+    void BasParser::DecodeProgram(Source& source, std::string& out, Flush flush, speccybasic::ConversionStats* stats,
+                                  speccybasic::Diagnostics* diagnostics) const {
+        speccybasic::ScopedTimer headerTimer(stats ? &stats->HeaderNs : nullptr);
+
+        // Lines are joined with '\n' as they go, mirroring JS `.join('\n')`, so nothing has to be
+        // taken back off the end once earlier text may already have been flushed
+        bool firstLine = true;
+        auto beginLine = [&]() {
+            if (!firstLine) out += '\n';
+            firstLine = false;
+        };
+
+        int autoStart;
+        bool banked = SkipHeaders(source, autoStart);
+        if (autoStart != 0) {
+            beginLine();
+            out += "#autostart ";
+            AppendNumber(out, autoStart);
+        }
+
+        headerTimer.Stop();
+
+        // Stream flushes are timed as writes, so they are taken back out of the decode time below
+        uint64_t writeBefore = stats ? stats->WriteNs : 0;
+        speccybasic::ScopedTimer decodeTimer(stats ? &stats->DecodeNs : nullptr);
+
+        // Iterate through BASIC lines
+        int lineNum;
+        size_t lineLen;
+        while (const uint8_t* lineData = NextLine(source, banked, lineNum, lineLen, diagnostics)) {
+            beginLine();
+            DecodeLine(lineNum, lineData, lineLen, out, stats);
+            flush(out);
+        }
+
+        decodeTimer.Stop();
+        if (stats) {
+            stats->DecodeNs -= stats->WriteNs - writeBefore;
+            stats->InputBytes += source.Consumed();
+        }
+    }
+
+    std::pair<size_t, size_t> LineIndex::Range(int first, int last) const {
+        auto begin = std::lower_bound(Lines.begin(), Lines.end(), first, [](const Line& line, int number) { return line.Number < number; });
+        auto end = std::upper_bound(begin, Lines.end(), last, [](int number, const Line& line) { return number < line.Number; });
+        if (end < begin) end = begin;
+        return { static_cast<size_t>(begin - Lines.begin()), static_cast<size_t>(end - Lines.begin()) };
+    }
+
+    LineIndex BasParser::BuildIndex(const uint8_t* data, size_t size, speccybasic::Diagnostics* diagnostics) const {
+        LineIndex index;
+        MemorySource source(data, size);
+        bool banked = SkipHeaders(source, index.AutoStartLine);
+
+        int lineNum;
+        size_t lineLen;
+        bool sorted = true;
+        while (const uint8_t* lineData = NextLine(source, banked, lineNum, lineLen, diagnostics)) {
+            if (!index.Lines.empty() && lineNum < index.Lines.back().Number) sorted = false;
+            index.Lines.push_back({ lineNum, static_cast<size_t>(lineData - data), lineLen });
+        }
+        // Programs are normally in line order already; edited or merged ones may not be
+        if (!sorted) {
+            std::stable_sort(index.Lines.begin(), index.Lines.end(),
+                             [](const LineIndex::Line& a, const LineIndex::Line& b) { return a.Number < b.Number; });
+        }
+        return index;
+    }
+
+    void BasParser::ParseLines(const uint8_t* data, const LineIndex& index, int first, int last, std::string& out,
+                               speccybasic::ConversionStats* stats) const {
+        speccybasic::ScopedTimer decodeTimer(stats ? &stats->DecodeNs : nullptr);
+        size_t outStart = out.size();
+        std::pair<size_t, size_t> range = index.Range(first, last);
+        for (size_t n = range.first; n < range.second; n++) {
+            const LineIndex::Line& line = index.Lines[n];
+            if (n > range.first) out += '\n';
+            DecodeLine(line.Number, data + line.Offset, line.Length, out, stats);
+            if (stats) stats->InputBytes += 4 + line.Length;
+        }
+        if (stats) stats->OutputBytes += out.size() - outStart;
+    }
+
+    template <bool Counting>
+    void BasParser::DecodeLineData(const uint8_t* data, size_t start, size_t length, std::string& out,
+                                   speccybasic::ConversionStats* stats) const {
+        if constexpr (!Counting) stats = nullptr; // Folds the counters away
+        size_t end = start + length;
+
+        bool inString = false;
+        bool inComment = false;
+        int lastNonWhitespace = -1;
+        int lastToken = -1;
+
+        for (size_t i = start; i < end; i++) {
+            uint8_t c = data[i];
+
+            if (c == 0x0D) {
+                break;
+            }
+
+            uint8_t peek = (i + 1 < end) ? data[i + 1] : 0;
+            char chr = static_cast<char>(c);
+
+            if (inString || inComment) {
+                if (c == 0x60 || c == 0x7F) { // BASIC_CHRS maps
+                    out += GetUnicodeChar(c);
+                } else if (c == 0x22) {
+                    out += chr;
+                } else {
+                    // Copy up to the next byte that needs a decision in one go. The run's last byte
+                    // becomes c, so the bookkeeping below still sees it; the rest only matter for
+                    // lastNonWhitespace when the run ends in spaces.
+                    size_t run = 1 + speccybasic::FindAnyOf(data + i + 1, end - i - 1, 0x0D, 0x22, 0x60, 0x7F);
+                    out.append(reinterpret_cast<const char*>(data + i), run);
+                    size_t last = i + run - 1;
+                    if (data[last] == ' ') {
+                        for (size_t n = last; n-- > i; ) {
+                            if (data[n] != ' ') {
+                                lastNonWhitespace = static_cast<char>(data[n]);
+                                break;
+                            }
+                        }
+                    }
+                    i = last;
+                    c = data[i];
+                    chr = static_cast<char>(c);
+                }
+            } else {
+                if (chr == ';') {
+                    // check if we're starting a comment
+                    if (lastNonWhitespace == -1 || lastNonWhitespace == ':') {
+                        inComment = true;
+                    }
+                    out += chr;
+                    if (speccybasic::TokenAttributes[peek] & speccybasic::IsToken) {
+                        out += ' ';
+                    }
+                } else if (chr == ':') {
+                    out += chr;
+                    if (peek == ';') {
+                        out += ' ';
+                    }
+                } else if (speccybasic::TokenAttributes[c] & speccybasic::IsToken) {
+                    if (stats) stats->Tokens++;
+                    if (speccybasic::TokenAttributes[c] & speccybasic::RestOfLine) {
+                        inComment = true;
+                    }
+
+                    // JS also spaces after a previous token spelled ":", which no token is
+                    if (lastToken != -1 && !(speccybasic::TokenAttributes[lastToken] & speccybasic::IsToken) && lastToken != ' ') {
+                        out += ' ';
+                    }
+                    out += speccybasic::DecodeTable[c];
+                    out += ' ';
+                } else if (c == 0x0E) {
+                    // jump over numeric 5-byte payload.
+                    // Let the loop naturally close so `last` correctly registers this mathematical block format
+                    if (stats) stats->Numbers++;
+                    i += 5;
+                } else {
+                    out += chr;
+                }
+            }
+
+            if (c == 0x22) { // '"'
+                inString = !inString;
+            }
+
+            if (chr != ' ') {
+                lastNonWhitespace = chr;
+            }
+
+            lastToken = c;
+        }
+    }
+} // namespace bas2txt
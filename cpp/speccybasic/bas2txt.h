@@ -0,0 +1,72 @@
+#ifndef BAS2TXT_H
+#define BAS2TXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "diagnostics.h"
+#include "stats.h"
+
+namespace bas2txt {
+
+    // Where every line of a .bas image sits, from one walk over the 4-byte line headers. It holds
+    // offsets only, so it stays valid for as long as the image it was built from is unchanged, and can
+    // be kept to answer any number of range queries.
+    struct LineIndex {
+        struct Line {
+            int Number;
+            size_t Offset; // Of the line's tokens, just past its header
+            size_t Length; // Including the closing 0x0D
+        };
+
+        // Sorted by line number; lines that share a number keep their file order
+        std::vector<Line> Lines;
+        int AutoStartLine = 0; // 0 when the header gives none
+
+        // Positions [begin, end) in Lines of the lines numbered first to last inclusive, by binary search
+        std::pair<size_t, size_t> Range(int first, int last) const;
+    };
+
+    // Stateless, so one instance can be shared by any number of files and threads
+    class BasParser {
+    private:
+        // Appends the text of one line's tokens to out, without the line number; Counting fills in stats
+        template <bool Counting>
+        void DecodeLineData(const uint8_t* data, size_t start, size_t length, std::string& out,
+                            speccybasic::ConversionStats* stats) const;
+
+        // Appends one line as "<number> <text>", trimmed as the JS tool does
+        void DecodeLine(int lineNum, const uint8_t* lineData, size_t lineLen, std::string& out,
+                        speccybasic::ConversionStats* stats) const;
+
+        // Shared by Parse and ParseStream; Source supplies the bytes, flush(out) may drain the text so far
+        template <typename Source, typename Flush>
+        void DecodeProgram(Source& source, std::string& out, Flush flush, speccybasic::ConversionStats* stats,
+                           speccybasic::Diagnostics* diagnostics) const;
+
+    public:
+        std::string Parse(const std::vector<uint8_t>& data) const;
+        // Decodes a whole .bas image, appending the listing to out; fills in stats when given one. A line
+        // numbered above 9999 throws, or with diagnostics is recorded there and ends the listing.
+        void Parse(const uint8_t* data, size_t size, std::string& out, speccybasic::ConversionStats* stats = nullptr,
+                   speccybasic::Diagnostics* diagnostics = nullptr) const;
+        // Decodes incrementally from in to out (e.g. stdin/stdout) holding at most one line in memory
+        void ParseStream(std::FILE* in, std::FILE* out, speccybasic::ConversionStats* stats = nullptr,
+                         speccybasic::Diagnostics* diagnostics = nullptr) const;
+
+        // Walks the line headers without decoding anything; malformed images throw, or are cut short, as
+        // with Parse
+        LineIndex BuildIndex(const uint8_t* data, size_t size, speccybasic::Diagnostics* diagnostics = nullptr) const;
+        // Decodes only the lines numbered first to last, straight from data, joined with '\n' like Parse.
+        // No #autostart line is written; index must have been built from this data.
+        void ParseLines(const uint8_t* data, const LineIndex& index, int first, int last, std::string& out,
+                        speccybasic::ConversionStats* stats = nullptr) const;
+    };
+
+} // namespace bas2txt
+
+#endif // BAS2TXT_H
\ No newline at end of file
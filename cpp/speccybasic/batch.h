@@ -0,0 +1,194 @@
+#ifndef SPECCYBASIC_BATCH_H
+#define SPECCYBASIC_BATCH_H
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "diagnostics.h"
+#include "workpool.h"
+
+// Command-line batch support shared by txt2bas and bas2txt: one process, one converter, many files.
+namespace speccybasic {
+
+    struct BatchJob {
+        std::string Input;
+        std::string Output;
+    };
+
+    struct BatchOptions {
+        std::vector<BatchJob> Jobs;
+        unsigned Threads = 1; // -j N; 0 picks one worker per hardware thread
+    };
+
+    struct BatchResult {
+        BatchJob Job;
+        bool Success = false;
+        std::string Message;
+        Diagnostics Warnings; // What the conversion worked around, kept even when it failed later
+    };
+
+    // Every regular file in inputDir, written to outputDir under the same stem with outputExtension
+    inline void AddDirectoryJobs(const std::string& inputDir, const std::string& outputDir,
+                                 const std::string& outputExtension, std::vector<BatchJob>& jobs) {
+        namespace fs = std::filesystem;
+        if (!fs::is_directory(inputDir)) throw std::runtime_error("Not a directory: " + inputDir);
+        fs::create_directories(outputDir);
+
+        std::vector<fs::path> inputs;
+        for (const auto& entry : fs::directory_iterator(inputDir)) {
+            if (entry.is_regular_file()) inputs.push_back(entry.path());
+        }
+        std::sort(inputs.begin(), inputs.end());
+
+        for (const fs::path& input : inputs) {
+            fs::path output = fs::path(outputDir) / input.stem();
+            output += outputExtension;
+            jobs.push_back({input.string(), output.string()});
+        }
+    }
+
+    // One pair per line, "input<TAB>output" or whitespace separated; blank lines and '#' comments are skipped
+    inline void AddManifestJobs(const std::string& manifestPath, std::vector<BatchJob>& jobs) {
+        std::ifstream manifest(manifestPath);
+        if (!manifest.is_open()) throw std::runtime_error("Could not open manifest: " + manifestPath);
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(manifest, line)) {
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+
+            size_t first = line.find_first_not_of(" \t");
+            if (first == std::string::npos || line[first] == '#') continue;
+
+            size_t split = line.find('\t', first);
+            if (split == std::string::npos) split = line.find(' ', first);
+            size_t second = (split == std::string::npos) ? std::string::npos : line.find_first_not_of(" \t", split);
+            if (second == std::string::npos) {
+                throw std::runtime_error(manifestPath + ":" + std::to_string(lineNumber) + ": expected <input> <output>");
+            }
+
+            size_t last = line.find_last_not_of(" \t");
+            jobs.push_back({line.substr(first, split - first), line.substr(second, last - second + 1)});
+        }
+    }
+
+    inline unsigned ParseThreadCount(const std::string& value) {
+        size_t used = 0;
+        unsigned long threads = 0;
+        try {
+            threads = std::stoul(value, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || used != value.length() || threads > 1024) throw std::runtime_error("-j expects a thread count, got: " + value);
+        return static_cast<unsigned>(threads);
+    }
+
+    // Collects jobs from --batch <in> <out>..., --dir <in-dir> <out-dir> and --manifest <file>, in any mix,
+    // plus -j N to convert N files at a time. args excludes the program name and the tool's own flags.
+    inline BatchOptions ParseBatchArguments(const std::vector<std::string>& args, const std::string& outputExtension) {
+        BatchOptions options;
+        std::vector<BatchJob>& jobs = options.Jobs;
+        size_t count = args.size();
+        for (size_t i = 0; i < count; i++) {
+            const std::string& arg = args[i];
+            if (arg == "-j") {
+                if (i + 1 >= count) throw std::runtime_error("-j expects a thread count");
+                options.Threads = ParseThreadCount(args[++i]);
+            } else if (arg.rfind("-j", 0) == 0) {
+                options.Threads = ParseThreadCount(arg.substr(2));
+            } else if (arg == "--dir") {
+                if (i + 2 >= count) throw std::runtime_error("--dir expects <input-dir> <output-dir>");
+                AddDirectoryJobs(args[i + 1], args[i + 2], outputExtension, jobs);
+                i += 2;
+            } else if (arg == "--manifest") {
+                if (i + 1 >= count) throw std::runtime_error("--manifest expects <file>");
+                AddManifestJobs(args[i + 1], jobs);
+                i += 1;
+            } else if (arg == "--batch") {
+                while (i + 1 < count && args[i + 1].rfind("-", 0) != 0) {
+                    if (i + 2 >= count) throw std::runtime_error("--batch: no output given for " + args[i + 1]);
+                    jobs.push_back({args[i + 1], args[i + 2]});
+                    i += 2;
+                }
+            } else {
+                throw std::runtime_error("Unknown batch option: " + arg);
+            }
+        }
+        return options;
+    }
+
+    // Plain input paths with an optional -j N among them, as --analyze takes them
+    inline std::vector<std::string> ParseInputArguments(const std::vector<std::string>& args, unsigned& threads) {
+        std::vector<std::string> inputs;
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i] == "-j") {
+                if (i + 1 >= args.size()) throw std::runtime_error("-j expects a thread count");
+                threads = ParseThreadCount(args[++i]);
+            } else if (args[i].rfind("-j", 0) == 0) {
+                threads = ParseThreadCount(args[i].substr(2));
+            } else {
+                inputs.push_back(args[i]);
+            }
+        }
+        return inputs;
+    }
+
+    inline bool IsBatchArgument(const std::string& arg) {
+        return arg == "--batch" || arg == "--dir" || arg == "--manifest" || arg.rfind("-j", 0) == 0;
+    }
+
+    // Runs convert(job, warnings) for every job on a work-stealing pool of `threads` workers, turning
+    // exceptions into per-file failures so one bad file doesn't stop the run. convert returns the success
+    // message for the report, records anything it worked around in warnings, and must be safe to call
+    // concurrently. Results keep the order of the jobs.
+    template <typename Convert>
+    std::vector<BatchResult> RunBatch(const std::vector<BatchJob>& jobs, unsigned threads, Convert convert) {
+        std::vector<BatchResult> results(jobs.size());
+        RunWorkStealing(jobs.size(), threads, [&](size_t index, unsigned) {
+            BatchResult& result = results[index];
+            result.Job = jobs[index];
+            try {
+                result.Message = convert(jobs[index], result.Warnings);
+                result.Success = true;
+            } catch (const std::exception& ex) {
+                result.Message = ex.what();
+            }
+        });
+        return results;
+    }
+
+    // Prints one status line per file, each followed by its warnings, and a summary; returns the number
+    // of failures
+    inline size_t PrintBatchReport(const std::vector<BatchResult>& results, std::ostream& out) {
+        size_t failed = 0;
+        size_t warnings = 0;
+        for (const BatchResult& result : results) {
+            if (result.Success) {
+                out << "OK     " << result.Job.Input << " -> " << result.Job.Output << " (" << result.Message << ")\n";
+            } else {
+                out << "FAILED " << result.Job.Input << ": " << result.Message << "\n";
+                failed++;
+            }
+            for (const Diagnostic& diagnostic : result.Warnings.Items) {
+                out << "       warning: " << FormatDiagnostic(diagnostic) << "\n";
+            }
+            warnings += result.Warnings.Items.size();
+        }
+        out << "Converted " << (results.size() - failed) << " of " << results.size() << " files";
+        if (failed > 0) out << " (" << failed << " failed)";
+        if (warnings > 0) out << ", " << warnings << (warnings == 1 ? " warning" : " warnings");
+        out << "\n";
+        return failed;
+    }
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_BATCH_H
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef SPECCYBASIC_DIAGNOSTICS_H
+#define SPECCYBASIC_DIAGNOSTICS_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace speccybasic {
+
+    enum class DiagnosticCode : uint8_t {
+        NumberOutOfRange, // txt2bas: a literal too large or too small to pack, stored as 0
+        InvalidNumber,    // txt2bas: a $hex or @binary literal with no digits where some are needed, stored as 0
+        LineOutOfRange,   // bas2txt: a line numbered above 9999; the listing stops before it
+    };
+
+    inline const char* DiagnosticCodeName(DiagnosticCode code) {
+        switch (code) {
+            case DiagnosticCode::NumberOutOfRange: return "number-out-of-range";
+            case DiagnosticCode::InvalidNumber: return "invalid-number";
+            case DiagnosticCode::LineOutOfRange: return "line-out-of-range";
+        }
+        return "unknown";
+    }
+
+    struct Diagnostic {
+        int Line = 0;   // BASIC line number
+        int Column = 0; // 1-based, in the text after the line number; 0 when it applies to the whole line
+        DiagnosticCode Code = DiagnosticCode::InvalidNumber;
+        std::string Message;
+    };
+
+    // Problems a conversion worked around instead of stopping for, recorded only when the converter is
+    // handed a collector. Without one, bas2txt still throws at a line above 9999 as it always has.
+    struct Diagnostics {
+        std::vector<Diagnostic> Items;
+
+        bool Empty() const { return Items.empty(); }
+
+        void Add(int line, int column, DiagnosticCode code, std::string message) {
+            Items.push_back({ line, column, code, std::move(message) });
+        }
+
+        // Appends what a parallel chunk or another file collected, keeping its order
+        void Append(const Diagnostics& other) {
+            Items.insert(Items.end(), other.Items.begin(), other.Items.end());
+        }
+    };
+
+    // "line 10, column 7: <message> [code]"
+    inline std::string FormatDiagnostic(const Diagnostic& diagnostic) {
+        std::string text = "line " + std::to_string(diagnostic.Line);
+        if (diagnostic.Column > 0) text += ", column " + std::to_string(diagnostic.Column);
+        text += ": " + diagnostic.Message + " [" + DiagnosticCodeName(diagnostic.Code) + "]";
+        return text;
+    }
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_DIAGNOSTICS_H
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "linecache.h"
+#include <cstring>
+
+namespace txt2bas {
+
+    // "T2BCACHE", format version, tokenizer version, entry count; then per entry the line number,
+    // variant, text and bytes, every integer 32-bit little-endian
+    static constexpr char Magic[8] = { 'T', '2', 'B', 'C', 'A', 'C', 'H', 'E' };
+    static constexpr uint32_t FormatVersion = 2;
+
+    uint64_t LineCache::Key(int lineNum, std::string_view text, uint8_t variant) {
+        // FNV-1a over the version, variant, line number and text
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](uint8_t byte) { hash = (hash ^ byte) * 1099511628211ull; };
+        for (int shift = 0; shift < 32; shift += 8) mix(static_cast<uint8_t>(TokenizerVersion >> shift));
+        mix(variant);
+        for (int shift = 0; shift < 32; shift += 8) mix(static_cast<uint8_t>(static_cast<uint32_t>(lineNum) >> shift));
+        for (char c : text) mix(static_cast<uint8_t>(c));
+        return hash;
+    }
+
+    const std::vector<uint8_t>* LineCache::Find(int lineNum, std::string_view text, uint8_t variant) {
+        auto range = _entries.equal_range(Key(lineNum, text, variant));
+        for (auto it = range.first; it != range.second; ++it) {
+            Entry& entry = it->second;
+            if (entry.LineNum == lineNum && entry.Variant == variant && entry.Text == text) {
+                entry.Used = true;
+                Hits++;
+                return &entry.Bytes;
+            }
+        }
+        Misses++;
+        return nullptr;
+    }
+
+    void LineCache::Store(int lineNum, std::string_view text, const uint8_t* bytes, size_t size, uint8_t variant) {
+        uint64_t key = Key(lineNum, text, variant);
+        auto range = _entries.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            Entry& entry = it->second;
+            if (entry.LineNum == lineNum && entry.Variant == variant && entry.Text == text) {
+                entry.Bytes.assign(bytes, bytes + size);
+                entry.Used = true;
+                return;
+            }
+        }
+        _entries.emplace(key, Entry{ lineNum, variant, std::string(text), std::vector<uint8_t>(bytes, bytes + size), true });
+    }
+
+    void LineCache::Prune() {
+        for (auto it = _entries.begin(); it != _entries.end(); ) {
+            if (!it->second.Used) {
+                it = _entries.erase(it);
+            } else {
+                it->second.Used = false;
+                ++it;
+            }
+        }
+    }
+
+    void LineCache::Clear() {
+        _entries.clear();
+        Hits = 0;
+        Misses = 0;
+    }
+
+    static void PutU32(std::vector<uint8_t>& out, uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+
+    std::vector<uint8_t> LineCache::Serialize() const {
+        std::vector<uint8_t> out(Magic, Magic + sizeof(Magic));
+        PutU32(out, FormatVersion);
+        PutU32(out, TokenizerVersion);
+        PutU32(out, static_cast<uint32_t>(_entries.size()));
+        for (const auto& item : _entries) {
+            const Entry& entry = item.second;
+            PutU32(out, static_cast<uint32_t>(entry.LineNum));
+            PutU32(out, entry.Variant);
+            PutU32(out, static_cast<uint32_t>(entry.Text.size()));
+            out.insert(out.end(), entry.Text.begin(), entry.Text.end());
+            PutU32(out, static_cast<uint32_t>(entry.Bytes.size()));
+            out.insert(out.end(), entry.Bytes.begin(), entry.Bytes.end());
+        }
+        return out;
+    }
+
+    bool LineCache::Deserialize(const uint8_t* data, size_t size) {
+        Clear();
+
+        size_t offset = 0;
+        auto take = [&](size_t n) -> const uint8_t* {
+            if (n > size - offset) return nullptr;
+            const uint8_t* bytes = data + offset;
+            offset += n;
+            return bytes;
+        };
+        auto takeU32 = [&](uint32_t& value) {
+            const uint8_t* bytes = take(4);
+            if (!bytes) return false;
+            value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+            return true;
+        };
+
+        const uint8_t* magic = take(sizeof(Magic));
+        uint32_t format, version, count;
+        if (!magic || std::memcmp(magic, Magic, sizeof(Magic)) != 0) return false;
+        if (!takeU32(format) || format != FormatVersion) return false;
+        if (!takeU32(version) || version != TokenizerVersion) return false;
+        if (!takeU32(count)) return false;
+
+        for (uint32_t n = 0; n < count; n++) {
+            uint32_t lineNum, variant, textLength, byteLength;
+            const uint8_t* text;
+            const uint8_t* bytes;
+            if (!takeU32(lineNum) || !takeU32(variant) || variant > 0xFF || !takeU32(textLength) || !(text = take(textLength)) ||
+                !takeU32(byteLength) || !(bytes = take(byteLength))) {
+                Clear();
+                return false;
+            }
+            // Loaded entries only survive the next Prune if that conversion uses them
+            std::string_view view(reinterpret_cast<const char*>(text), textLength);
+            int line = static_cast<int>(lineNum);
+            uint8_t tokenizer = static_cast<uint8_t>(variant);
+            _entries.emplace(Key(line, view, tokenizer),
+                             Entry{ line, tokenizer, std::string(view), std::vector<uint8_t>(bytes, bytes + byteLength), false });
+        }
+        return true;
+    }
+
+} // namespace txt2bas
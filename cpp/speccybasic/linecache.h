@@ -0,0 +1,61 @@
+#ifndef SPECCYBASIC_LINECACHE_H
+#define SPECCYBASIC_LINECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace txt2bas {
+
+    // Bump whenever ParseLine's output changes for any input, so stale caches are ignored
+    constexpr uint32_t TokenizerVersion = 2;
+
+    // Tokenized lines from earlier conversions, keyed by a hash of (line number, text, variant,
+    // TokenizerVersion). The variant names the tokenizer that made the bytes, so one dialect's lines are
+    // never replayed into another's output.
+    // ParseLine carries nothing from one line to the next, so a hit can be copied straight into the
+    // output. Not thread-safe; use one cache per file being converted.
+    class LineCache {
+    private:
+        struct Entry {
+            int LineNum;
+            uint8_t Variant;
+            std::string Text; // Compared on lookup, so a hash collision is a miss rather than wrong bytes
+            std::vector<uint8_t> Bytes;
+            bool Used;
+        };
+
+        std::unordered_multimap<uint64_t, Entry> _entries;
+
+        static uint64_t Key(int lineNum, std::string_view text, uint8_t variant);
+
+    public:
+        size_t Hits = 0;
+        size_t Misses = 0;
+
+        // Variants BasConverter uses: Auto reads every listing as NextBasic does, so they share one
+        static constexpr uint8_t NextBasicVariant = 0;
+        static constexpr uint8_t Sinclair48KVariant = 1;
+
+        // The line's tokenized bytes (header to 0x0D), or nullptr on a miss
+        const std::vector<uint8_t>* Find(int lineNum, std::string_view text, uint8_t variant = NextBasicVariant);
+        void Store(int lineNum, std::string_view text, const uint8_t* bytes, size_t size, uint8_t variant = NextBasicVariant);
+
+        // Drops every entry not found or stored since the last Prune, so the cache follows the file
+        void Prune();
+        void Clear();
+        size_t Size() const { return _entries.size(); }
+
+        // Sidecar form for callers that keep the cache between runs. Deserialize replaces the contents
+        // and returns false, leaving the cache empty, for data from another tokenizer version or
+        // anything malformed.
+        std::vector<uint8_t> Serialize() const;
+        bool Deserialize(const uint8_t* data, size_t size);
+    };
+
+} // namespace txt2bas
+
+#endif // SPECCYBASIC_LINECACHE_H
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "mappedfile.h"
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace speccybasic {
+
+#ifdef _WIN32
+
+    bool MappedFile::Open(const std::string& path) {
+        Close();
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (view) {
+                CloseHandle(file);
+                _mapping = mapping;
+                _data = static_cast<const uint8_t*>(view);
+                _size = static_cast<size_t>(size.QuadPart);
+                _mapped = true;
+                return true;
+            }
+            if (mapping) CloseHandle(mapping);
+        }
+
+        char chunk[65536];
+        DWORD got = 0;
+        BOOL ok;
+        while ((ok = ReadFile(file, chunk, sizeof(chunk), &got, nullptr)) && got > 0) {
+            _buffer.insert(_buffer.end(), chunk, chunk + got);
+        }
+        // A pipe whose writer has gone reports ERROR_BROKEN_PIPE rather than a zero-length read
+        bool failed = !ok && GetLastError() != ERROR_BROKEN_PIPE;
+        CloseHandle(file);
+        if (failed) throw std::runtime_error("Failed to read " + path);
+        _data = _buffer.data();
+        _size = _buffer.size();
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (_mapped) {
+            UnmapViewOfFile(_data);
+            CloseHandle(static_cast<HANDLE>(_mapping));
+            _mapping = nullptr;
+        }
+        _buffer.clear();
+        _data = nullptr;
+        _size = 0;
+        _mapped = false;
+    }
+
+#else
+
+    bool MappedFile::Open(const std::string& path) {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            size_t size = static_cast<size_t>(info.st_size);
+            void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                close(fd);
+                // Both converters make one pass from start to end
+                madvise(view, size, MADV_SEQUENTIAL);
+                _data = static_cast<const uint8_t*>(view);
+                _size = size;
+                _mapped = true;
+                return true;
+            }
+        }
+
+        uint8_t chunk[65536];
+        ssize_t got;
+        while ((got = read(fd, chunk, sizeof(chunk))) != 0) {
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                close(fd);
+                throw std::runtime_error("Failed to read " + path);
+            }
+            _buffer.insert(_buffer.end(), chunk, chunk + got);
+        }
+        close(fd);
+        _data = _buffer.data();
+        _size = _buffer.size();
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (_mapped) munmap(const_cast<uint8_t*>(_data), _size);
+        _buffer.clear();
+        _data = nullptr;
+        _size = 0;
+        _mapped = false;
+    }
+
+#endif
+
+} // namespace speccybasic
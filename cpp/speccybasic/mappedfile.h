@@ -0,0 +1,46 @@
+#ifndef SPECCYBASIC_MAPPEDFILE_H
+#define SPECCYBASIC_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only input files for the CLIs. Not part of the library, which never touches files.
+namespace speccybasic {
+
+    // A regular file is memory-mapped (mmap, or MapViewOfFile on Windows) so the converters read the
+    // page cache directly instead of a private copy. Anything that cannot be mapped, such as a pipe,
+    // a FIFO or an empty file, is read into memory instead. The file must not shrink while it is open.
+    class MappedFile {
+    private:
+        const uint8_t* _data = nullptr;
+        size_t _size = 0;
+        bool _mapped = false;
+        std::vector<uint8_t> _buffer; // Fallback copy when not mapped
+#ifdef _WIN32
+        void* _mapping = nullptr;
+#endif
+
+        void Close();
+
+    public:
+        MappedFile() = default;
+        ~MappedFile() { Close(); }
+
+        // False when the file cannot be opened; a failed read throws std::runtime_error
+        bool Open(const std::string& path);
+
+        const uint8_t* Data() const { return _data; }
+        size_t Size() const { return _size; }
+        std::string_view Text() const { return std::string_view(reinterpret_cast<const char*>(_data), _size); }
+        bool IsMapped() const { return _mapped; }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_MAPPEDFILE_H
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef SPECCYBASIC_NUMBER_H
+#define SPECCYBASIC_NUMBER_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace speccybasic {
+
+    // The 5-byte form Sinclair BASIC hides after every numeric literal (behind a 0x0E marker)
+    class SinclairNumber {
+    public:
+        using Packed = std::array<uint8_t, 5>;
+
+        static Packed Pack(double number) {
+            // First check if it can be a compact integer
+            double intPart;
+            if (std::modf(number, &intPart) == 0.0 && number >= -65535.0 && number <= 65535.0) {
+                int val = static_cast<int>(number);
+                uint8_t sign = (val < 0) ? 0xFF : 0x00;
+                // JS version directly casts signed integer into setUint16 -> two's complement applies natively
+                uint16_t uval = static_cast<uint16_t>(val);
+                return {{0x00, sign, static_cast<uint8_t>(uval & 0xFF), static_cast<uint8_t>((uval >> 8) & 0xFF), 0x00}};
+            }
+
+            // Float to ZX format conversion
+            bool sign = (number < 0.0);
+            if (sign) number = -number;
+
+            Packed out{};
+
+            if (number == 0.0) return out;
+
+            // number = fraction * 2^exponent with fraction in [0.5, 1), the range the old halving/doubling loops produced
+            int exponent = 0;
+            double fraction = std::frexp(number, &exponent);
+            out[0] = static_cast<uint8_t>(0x80 + exponent);
+
+            // Rounding can carry a fraction just below 1.0 up to 2^32, which wraps to zero as the old uint32 cast did
+            uint32_t mantissa = static_cast<uint32_t>(static_cast<uint64_t>(fraction * 4294967296.0 + 0.5));
+
+            out[1] = static_cast<uint8_t>((mantissa >> 24) & 0xFF);
+            out[2] = static_cast<uint8_t>((mantissa >> 16) & 0xFF);
+            out[3] = static_cast<uint8_t>((mantissa >> 8) & 0xFF);
+            out[4] = static_cast<uint8_t>(mantissa & 0xFF);
+
+            if (!sign) out[1] &= 0x7F;
+
+            return out;
+        }
+
+        // Inverse of Pack for the bytes following a 0x0E marker
+        static double Unpack(const uint8_t* bytes) {
+            if (bytes[0] == 0x00) {
+                int value = bytes[2] | (bytes[3] << 8);
+                return (bytes[1] == 0xFF) ? value - 65536.0 : static_cast<double>(value);
+            }
+
+            // Bit 7 of the first mantissa byte holds the sign; the leading 1 it replaces is implied
+            uint32_t mantissa = (static_cast<uint32_t>(bytes[1] | 0x80) << 24) | (bytes[2] << 16) | (bytes[3] << 8) | bytes[4];
+            double value = std::ldexp(static_cast<double>(mantissa), bytes[0] - 0x80 - 32);
+            return (bytes[1] & 0x80) ? -value : value;
+        }
+    };
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_NUMBER_H
\ No newline at end of file
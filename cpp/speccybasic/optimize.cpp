@@ -0,0 +1,326 @@
+#include "optimize.h"
+#include "analyze.h"
+#include "tokens.h"
+#include <algorithm>
+#include <cctype>
+
+namespace txt2bas {
+
+    static constexpr uint8_t TokenVal = 0xB0;
+    static constexpr uint8_t TokenSgn = 0xBC;
+    static constexpr uint8_t TokenNot = 0xC3;
+    static constexpr uint8_t TokenPi = 0xA7;
+    static constexpr uint8_t TokenOr = 0xC5;
+    static constexpr uint8_t TokenAnd = 0xC6;
+    static constexpr uint8_t TokenIf = 0xFA;
+    static constexpr uint8_t TokenThen = 0xCB;
+    static constexpr uint8_t TokenTo = 0xCC;
+    static constexpr uint8_t TokenStep = 0xCD;
+    static constexpr uint8_t TokenElse = 0x98;
+    static constexpr uint8_t TokenDefFn = 0xCE;
+
+    // Bytes that end the expression a literal closes
+    static bool EndsExpression(int c) {
+        return c == 0x0D || c == ':' || c == ',' || c == ';' || c == ')' || c == '\'' ||
+               c == TokenThen || c == TokenTo || c == TokenStep || c == TokenElse;
+    }
+
+    // Bytes after which a %n can stand for the whole operand: an assignment, a separator, an open
+    // bracket, or a keyword that takes an argument. Operators would pull the rest of the expression in.
+    static bool StartsValue(int c) {
+        if (c == '=' || c == ',' || c == '(' || c == ';' || c == '\'') return true;
+        if (c < 0) return false;
+        uint16_t attributes = speccybasic::TokenAttributes[c];
+        return (attributes & speccybasic::IsToken) && !(attributes & (speccybasic::IntOperator | speccybasic::IntFunction));
+    }
+
+    // The first byte after data[from] other than a space, or 0x0D at the end of the line
+    static int NextSignificant(const uint8_t* data, size_t from, size_t length) {
+        while (from < length && data[from] == ' ') from++;
+        return from < length ? data[from] : 0x0D;
+    }
+
+    // Whether byte appears outside strings, REMs and number payloads
+    static bool Holds(const uint8_t* data, size_t length, uint8_t byte) {
+        bool inString = false;
+        for (size_t i = 0; i < length && data[i] != 0x0D; i++) {
+            uint8_t c = data[i];
+            if (c == '"') inString = !inString;
+            if (inString) continue;
+            if (c == byte) return true;
+            if (speccybasic::TokenAttributes[c] & speccybasic::RestOfLine) return false;
+            if (c == 0x0E) i += 5;
+        }
+        return false;
+    }
+
+    // Whether data[from, to) holds THEN as a word, in any case, as txt2bas looks for it to tell an IF
+    // from a block IF; REM text is not spared
+    static bool HoldsThen(const uint8_t* data, size_t from, size_t to) {
+        auto isWordChar = [](uint8_t c) { return std::isalnum(c) || c == '_'; };
+        for (size_t p = from; p + 4 <= to; p++) {
+            bool then = std::toupper(data[p]) == 'T' && std::toupper(data[p + 1]) == 'H' &&
+                        std::toupper(data[p + 2]) == 'E' && std::toupper(data[p + 3]) == 'N';
+            if (then && (p == from || !isWordChar(data[p - 1])) && (p + 4 == to || !isWordChar(data[p + 4]))) return true;
+        }
+        return false;
+    }
+
+    // Whether the last IF token before data[end] has no THEN token after it, strings and payloads aside.
+    // The line's own bytes are read, as a dot command's are copied without being looked at.
+    static bool AwaitsThen(const uint8_t* data, size_t end) {
+        bool inString = false;
+        bool awaits = false;
+        for (size_t i = 0; i < end; i++) {
+            uint8_t c = data[i];
+            if (c == '"') inString = !inString;
+            if (inString) continue;
+            if (c == TokenIf) awaits = true;
+            if (c == TokenThen) awaits = false;
+            if (c == 0x0E) i += 5;
+        }
+        return awaits;
+    }
+
+    // What a line's literals may become. A line never gets both: after a %n NextBASIC reads the rest of
+    // the statement as integers, and with the % a rewritten line would keep its keywords on a second pass.
+    enum class LiteralForms { Keywords, Ints };
+
+    // Rewrites one line's data (up to and including its 0x0D) into out. significant holds every byte
+    // written other than a space, with each number payload as a single 0x0E, so the byte before any
+    // position is one lookup even when the payload bytes look like spaces. With Ints, false means a
+    // literal was left as it was after a %n in its statement, which its payload would not survive.
+    static bool OptimizeLine(const uint8_t* data, size_t length, std::vector<uint8_t>& out, std::vector<int>& significant,
+                             const OptimizeOptions& options, LiteralForms forms, OptimizeSavings& savings) {
+        auto previous = [&significant]() { return significant.empty() ? -1 : significant.back(); };
+        auto emit = [&out, &significant](uint8_t c) {
+            out.push_back(c);
+            if (c != ' ') significant.push_back(c);
+        };
+
+        // NextBASIC may read any part of a line with a % in it as integers, where neither %n nor PI nor
+        // VAL can stand in for a literal, so such lines keep theirs
+        bool numbers = (options.Numbers || options.ValStrings) && !Holds(data, length, '%');
+        // txt2bas loses its place in a DEF FN after a string earlier in the line, and leaves out the
+        // argument markers, so VAL "n" can't go in front of one
+        bool strings = options.ValStrings && !Holds(data, length, TokenDefFn);
+        bool inString = false;
+        bool intWritten = false; // A %n in the statement so far
+        size_t payloadEnd = 0; // A literal's text never reaches back into the payload before it
+        size_t packedEnd = 0; // The end of the last payload in out, which trimming the line stops at
+        size_t i = 0;
+        while (i < length) {
+            uint8_t c = data[i];
+            if (c == 0x0D) {
+                out.insert(out.end(), data + i, data + length);
+                return true;
+            }
+
+            if (inString) {
+                out.push_back(c);
+                if (c == '"') inString = false;
+                i++;
+                continue;
+            }
+            if (c == '"') {
+                emit(c);
+                inString = true;
+                i++;
+                continue;
+            }
+            if (c == ' ') {
+                if (options.Spaces) savings.Spaces++;
+                else out.push_back(c);
+                i++;
+                continue;
+            }
+
+            // REM, or a ; comment where a statement starts; both run to the end of the line
+            int last = previous();
+            bool statementStart = last == -1 || (speccybasic::TokenAttributes[last] & speccybasic::StartsComment);
+            if ((speccybasic::TokenAttributes[c] & speccybasic::RestOfLine) || (c == ';' && statementStart)) {
+                size_t end = i;
+                while (end < length && data[end] != 0x0D) end++;
+                // A ':' straight after THEN or ELSE stays, so the IF still has a statement to run
+                int beforeColon = significant.size() > 1 ? significant[significant.size() - 2] : -1;
+                bool separate = last == ':' && beforeColon != -1 && !(speccybasic::TokenAttributes[beforeColon] &
+                                                                     speccybasic::CommandFollows);
+                // An IF that took its THEN from the comment would be read back as a block IF without it
+                bool keepsThen = AwaitsThen(data, i) && HoldsThen(data, i + 1, end);
+                if (!options.Rems || keepsThen) {
+                    out.insert(out.end(), data + i, data + end);
+                } else if (separate) {
+                    // The statement and the ':' in front of it go; the line keeps whatever came before
+                    size_t kept = out.size();
+                    while (out.back() == ' ') out.pop_back();
+                    out.pop_back();
+                    significant.pop_back();
+                    // Once listed, the line loses any whitespace it now ends with, dot command or not
+                    while (out.size() > packedEnd && std::isspace(out.back())) out.pop_back();
+                    savings.Rems += kept - out.size() + end - i;
+                } else {
+                    out.push_back(c);
+                    savings.Rems += end - i - 1;
+                }
+                i = end;
+                continue;
+            }
+
+            // Dot commands are handed to the command as they stand, up to a ':' outside quotes
+            bool commandStart = last == -1 || last == ':' || (speccybasic::TokenAttributes[last] & speccybasic::CommandFollows);
+            if (c == '.' && commandStart && !(i + 1 < length && std::isdigit(data[i + 1]))) {
+                bool quoted = false;
+                size_t end = i;
+                while (end < length && data[end] != 0x0D && (quoted || data[end] != ':')) {
+                    if (data[end] == '"') quoted = !quoted;
+                    end++;
+                }
+                out.insert(out.end(), data + i, data + end);
+                significant.push_back('.');
+                for (size_t k = i; k < end; k++) {
+                    // 48K BASIC tokenized it as any other text
+                    if (data[k] != 0x0E) continue;
+                    packedEnd = std::min(out.size(), out.size() - (end - k) + 6);
+                    k += 5;
+                }
+                i = end;
+                continue;
+            }
+
+            if (c == 0x0E && i + 6 <= length) {
+                const uint8_t* packed = data + i + 1;
+                size_t textLength = speccybasic::DecimalLiteralLength(data, payloadEnd, i);
+                size_t saved = 0;
+                enum class Form { Payload, Int, SgnPi, NotPi, Val } form = Form::Payload;
+
+                // A letter or digit straight after the payload is text the tokenizer left as it was, which
+                // a keyword in the literal's place would run into once listed
+                bool glued = i + 6 < length && std::isalnum(data[i + 6]);
+                if (textLength > 0 && numbers && !glued) {
+                    // Whole numbers up to 65535 are packed as 0, sign, low, high, 0
+                    bool whole = packed[0] == 0x00 && packed[1] == 0x00 && packed[4] == 0x00;
+                    int value = packed[2] | (packed[3] << 8);
+                    int before = significant.size() > textLength ? significant[significant.size() - textLength - 1] : -1;
+                    int after = NextSignificant(data, i + 6, length);
+
+                    // bas2txt lists a keyword after ';' with two spaces, a tab before it stays a tab, and
+                    // digits straight after a payload are a literal run on from the last; txt2bas
+                    // would read any of those back with a space the rewritten line doesn't have
+                    size_t textStart = i - textLength;
+                    int prior = textStart > payloadEnd ? data[textStart - 1] : (textStart > 0 ? 0x0E : -1);
+                    bool keywords = forms == LiteralForms::Keywords && prior != ';' && prior != '\t' && prior != 0x0E;
+
+                    auto consider = [&](Form candidate, size_t bytes) {
+                        if (bytes > saved) {
+                            saved = bytes;
+                            form = candidate;
+                        }
+                    };
+                    if (strings && keywords) consider(Form::Val, 3);
+                    if (options.Numbers && whole) {
+                        bool digits = std::all_of(data + i - textLength, data + i, [](uint8_t d) { return std::isdigit(d) != 0; });
+                        if (forms == LiteralForms::Ints && digits && StartsValue(before) && EndsExpression(after)) consider(Form::Int, 5);
+                        if (keywords && value == 1) consider(Form::SgnPi, textLength + 4);
+                        if (keywords && value == 0 && (EndsExpression(after) || after == TokenAnd || after == TokenOr)) {
+                            consider(Form::NotPi, textLength + 4);
+                        }
+                    }
+                }
+
+                if (form == Form::Payload) {
+                    if (intWritten) return false;
+                    out.insert(out.end(), data + i, data + i + 6);
+                    packedEnd = out.size();
+                    significant.push_back(0x0E);
+                } else {
+                    // The literal's text is the last thing written; take it back and write the new form
+                    out.resize(out.size() - textLength);
+                    significant.resize(significant.size() - textLength);
+                    const uint8_t* text = data + i - textLength;
+                    switch (form) {
+                        case Form::Int:
+                            intWritten = true;
+                            emit('%');
+                            for (size_t k = 0; k < textLength; k++) emit(text[k]);
+                            break;
+                        case Form::SgnPi:
+                            emit(TokenSgn);
+                            emit(TokenPi);
+                            break;
+                        case Form::NotPi:
+                            emit(TokenNot);
+                            emit(TokenPi);
+                            break;
+                        case Form::Val:
+                            emit(TokenVal);
+                            emit('"');
+                            for (size_t k = 0; k < textLength; k++) emit(text[k]);
+                            emit('"');
+                            break;
+                        case Form::Payload:
+                            break;
+                    }
+                    savings.Numbers += saved;
+                }
+                i += 6;
+                payloadEnd = i;
+                continue;
+            }
+
+            if (c == ':') intWritten = false;
+            emit(c);
+            i++;
+        }
+        return true;
+    }
+
+    OptimizeSavings OptimizeProgram(std::vector<uint8_t>& program, size_t start, const OptimizeOptions& options,
+                                    bool intExpressions) {
+        OptimizeSavings savings;
+        std::vector<uint8_t> line;
+        std::vector<uint8_t> ints;
+        std::vector<int> significant;
+
+        // Every line only shrinks, so each is rewritten over the space it came from
+        size_t read = start;
+        size_t write = start;
+        while (read + 4 <= program.size()) {
+            uint8_t number[2] = { program[read], program[read + 1] };
+            size_t length = program[read + 2] | (program[read + 3] << 8);
+            if (read + 4 + length > program.size()) break;
+
+            const uint8_t* body = program.data() + read + 4;
+            line.clear();
+            significant.clear();
+            OptimizeSavings lineSavings;
+            OptimizeLine(body, length, line, significant, options, LiteralForms::Keywords, lineSavings);
+            if (intExpressions && options.Numbers) {
+                // The same line with %n in place of SGN PI, NOT PI and VAL, if that comes out no longer
+                ints.clear();
+                significant.clear();
+                OptimizeSavings intSavings;
+                if (OptimizeLine(body, length, ints, significant, options, LiteralForms::Ints, intSavings) &&
+                    ints.size() <= line.size()) {
+                    line.swap(ints);
+                    lineSavings = intSavings;
+                }
+            }
+            savings.Spaces += lineSavings.Spaces;
+            savings.Rems += lineSavings.Rems;
+            savings.Numbers += lineSavings.Numbers;
+            read += 4 + length;
+
+            program[write] = number[0];
+            program[write + 1] = number[1];
+            program[write + 2] = static_cast<uint8_t>(line.size() & 0xFF);
+            program[write + 3] = static_cast<uint8_t>(line.size() >> 8);
+            std::copy(line.begin(), line.end(), program.begin() + write + 4);
+            write += 4 + line.size();
+        }
+        // Anything that isn't a whole line is left as it was
+        std::copy(program.begin() + read, program.end(), program.begin() + write);
+        program.resize(write + program.size() - read);
+        return savings;
+    }
+
+} // namespace txt2bas
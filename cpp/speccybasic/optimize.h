@@ -0,0 +1,39 @@
+#ifndef SPECCYBASIC_OPTIMIZE_H
+#define SPECCYBASIC_OPTIMIZE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace txt2bas {
+
+    // What --optimize may rewrite in a tokenized program. Every rewrite keeps what the program does;
+    // none renumbers or removes a line, since any line may be a GO TO target.
+    struct OptimizeOptions {
+        bool Spaces = false;     // Spaces outside strings, REMs, ; comments and dot commands
+        bool Rems = false;       // REM and ; comment text; a ": REM" statement goes altogether
+        bool Numbers = false;    // 1 as SGN PI, 0 as NOT PI where the expression ends, and with
+                                 // NextBASIC a whole number up to 65535 as %n where a value may start
+        bool ValStrings = false; // Any other decimal literal as VAL "n": 3 bytes smaller, slower to run
+
+        bool Any() const { return Spaces || Rems || Numbers || ValStrings; }
+    };
+
+    // Bytes each kind of rewrite took out
+    struct OptimizeSavings {
+        uint64_t Spaces = 0;
+        uint64_t Rems = 0;
+        uint64_t Numbers = 0; // SGN PI, NOT PI, %n and VAL "n" together
+
+        uint64_t Total() const { return Spaces + Rems + Numbers; }
+    };
+
+    // Rewrites the lines (4-byte header, body, 0x0D) from program[start] to the end in place and
+    // shrinks the vector to fit. intExpressions allows %n, which only NextBASIC reads; a line then gets
+    // %n or the keyword forms, whichever leaves it shorter, never both.
+    OptimizeSavings OptimizeProgram(std::vector<uint8_t>& program, size_t start, const OptimizeOptions& options,
+                                    bool intExpressions);
+
+} // namespace txt2bas
+
+#endif // SPECCYBASIC_OPTIMIZE_H
\ No newline at end of file
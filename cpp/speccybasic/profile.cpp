@@ -0,0 +1,307 @@
+#include "profile.h"
+#include "scan.h"
+#include "tokens.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static std::atomic<uint64_t> Allocations{ 0 };
+
+// Counting replacements for the global allocator; the array, nothrow and sized forms all route here
+void* operator new(std::size_t size) {
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+namespace speccybasic {
+
+    uint64_t AllocationCount() {
+        return Allocations.load(std::memory_order_relaxed);
+    }
+
+    uint64_t PeakRssBytes() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+        return 0;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss); // Already bytes on macOS
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    bool ParseStatsArgument(const std::string& arg, StatsOptions& options) {
+        for (const char* name : { "--stats", "--profile" }) {
+            std::string flag = name;
+            if (arg != flag && arg.rfind(flag + "=", 0) != 0) continue;
+
+            options.Enabled = true;
+            if (flag == "--profile") options.Profile = true;
+            if (arg.size() > flag.size()) options.Path = arg.substr(flag.size() + 1);
+            return true;
+        }
+        return false;
+    }
+
+    bool ParseAnalyzeArgument(const std::string& arg, StatsOptions& options) {
+        if (arg != "--analyze" && arg.rfind("--analyze=", 0) != 0) return false;
+        options.Enabled = true;
+        if (arg.size() > 9) options.Path = arg.substr(10);
+        return true;
+    }
+
+    static void AppendJsonString(std::string& json, const std::string& text) {
+        json += '"';
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                json += '\\';
+                json += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                json += escaped;
+            } else {
+                json += static_cast<char>(c);
+            }
+        }
+        json += '"';
+    }
+
+    static void AppendField(std::string& json, const char* name, uint64_t value, bool& first) {
+        if (!first) json += ", ";
+        first = false;
+        AppendJsonString(json, name);
+        json += ": ";
+        json += std::to_string(value);
+    }
+
+    static void AppendWarnings(std::string& json, const Diagnostics& warnings) {
+        if (warnings.Empty()) return;
+        json += ",\n     \"warnings\": [";
+        for (size_t n = 0; n < warnings.Items.size(); n++) {
+            const Diagnostic& warning = warnings.Items[n];
+            json += n == 0 ? "{\"line\": " : ", {\"line\": ";
+            json += std::to_string(warning.Line);
+            json += ", \"column\": " + std::to_string(warning.Column);
+            json += ", \"code\": ";
+            AppendJsonString(json, DiagnosticCodeName(warning.Code));
+            json += ", \"message\": ";
+            AppendJsonString(json, warning.Message);
+            json += "}";
+        }
+        json += "]";
+    }
+
+    std::string FormatStatsJson(const std::string& tool, const std::string& version, const std::vector<StatsEntry>& entries,
+                                uint64_t allocations, uint64_t totalNs, bool profile) {
+        bool tokenizer = tool == "txt2bas";
+        std::string json = "{\n  \"tool\": ";
+        AppendJsonString(json, tool);
+        json += ",\n  \"version\": ";
+        AppendJsonString(json, version);
+        json += ",\n  \"profile\": ";
+        json += profile ? "true" : "false";
+        json += ",\n  \"scanner\": ";
+        AppendJsonString(json, ScannerName());
+        json += ",\n  \"files\": [";
+
+        for (size_t n = 0; n < entries.size(); n++) {
+            const StatsEntry& entry = entries[n];
+            const ConversionStats& stats = entry.Stats;
+
+            json += n == 0 ? "\n    {" : ",\n    {";
+            json += "\"input\": ";
+            AppendJsonString(json, entry.Input);
+            json += ", \"output\": ";
+            AppendJsonString(json, entry.Output);
+            json += ", \"success\": ";
+            json += entry.Success ? "true" : "false";
+            if (!entry.Success) {
+                json += ", \"error\": ";
+                AppendJsonString(json, entry.Error);
+            }
+            AppendWarnings(json, entry.Warnings);
+
+            json += ",\n     \"timings_ns\": {";
+            bool first = true;
+            AppendField(json, "read", stats.ReadNs, first);
+            if (tokenizer) {
+                AppendField(json, "split", stats.SplitNs, first);
+                AppendField(json, "tokenize", stats.TokenizeNs, first);
+                if (profile) {
+                    AppendField(json, "keywords", stats.KeywordNs, first);
+                    AppendField(json, "numbers", stats.NumberNs, first);
+                    AppendField(json, "copy", stats.CopyNs, first);
+                }
+                if (stats.OptimizeNs > 0) AppendField(json, "optimize", stats.OptimizeNs, first);
+                if (stats.VerifyNs > 0) AppendField(json, "verify", stats.VerifyNs, first);
+            } else {
+                AppendField(json, "header", stats.HeaderNs, first);
+                AppendField(json, "decode", stats.DecodeNs, first);
+            }
+            AppendField(json, "write", stats.WriteNs, first);
+            AppendField(json, "total", entry.TotalNs, first);
+
+            json += "},\n     \"counters\": {";
+            first = true;
+            AppendField(json, "lines", stats.Lines, first);
+            AppendField(json, "tokens", stats.Tokens, first);
+            AppendField(json, "numbers", stats.Numbers, first);
+            AppendField(json, "input_bytes", stats.InputBytes, first);
+            AppendField(json, "output_bytes", stats.OutputBytes, first);
+            if (stats.SavedBytes > 0) AppendField(json, "saved_bytes", stats.SavedBytes, first);
+            // Only conversions that went through a line cache have these
+            if (stats.CacheHits + stats.CacheMisses > 0) {
+                AppendField(json, "cache_hits", stats.CacheHits, first);
+                AppendField(json, "cache_misses", stats.CacheMisses, first);
+            }
+            json += "}}";
+        }
+
+        json += entries.empty() ? "],\n" : "\n  ],\n";
+        json += "  \"allocations\": " + std::to_string(allocations) + ",\n";
+        json += "  \"peak_rss_bytes\": " + std::to_string(PeakRssBytes()) + ",\n";
+        json += "  \"total_ns\": " + std::to_string(totalNs) + "\n}\n";
+        return json;
+    }
+
+    // overhead, tokens, ... and their total, as one object
+    static void AppendBreakdown(std::string& json, const ByteBreakdown& bytes) {
+        json += "{";
+        bool first = true;
+        AppendField(json, "total", bytes.Total(), first);
+        AppendField(json, "overhead", bytes.Overhead, first);
+        AppendField(json, "tokens", bytes.Tokens, first);
+        AppendField(json, "strings", bytes.Strings, first);
+        AppendField(json, "rems", bytes.Rems, first);
+        AppendField(json, "numbers", bytes.Numbers, first);
+        AppendField(json, "spaces", bytes.Spaces, first);
+        AppendField(json, "other", bytes.Other, first);
+        json += "}";
+    }
+
+    // The parts shared by each program and the totals: bytes, literals, savings and token counts,
+    // the tokens most used first
+    static void AppendAnalysis(std::string& json, const ProgramAnalysis& analysis, const char* indent) {
+        json += ",\n";
+        json += indent;
+        json += "\"bytes\": ";
+        AppendBreakdown(json, analysis.Bytes);
+        json += ",\n";
+        json += indent;
+        json += "\"literals\": " + std::to_string(analysis.Literals) + ", \"savings\": {";
+        const std::pair<const char*, const Saving*> savings[] = {
+            { "val_strings", &analysis.ValStrings }, { "int_expressions", &analysis.IntExpressions },
+            { "pi_idioms", &analysis.PiIdioms }, { "best", &analysis.Best } };
+        for (const auto& saving : savings) {
+            if (saving.second != &analysis.ValStrings) json += ", ";
+            AppendJsonString(json, saving.first);
+            bool first = true;
+            json += ": {";
+            AppendField(json, "count", saving.second->Count, first);
+            AppendField(json, "bytes", saving.second->Bytes, first);
+            json += "}";
+        }
+        json += "},\n";
+        json += indent;
+        json += "\"tokens\": {";
+
+        std::vector<size_t> used;
+        for (size_t token = 0; token < analysis.TokenCounts.size(); token++) {
+            if (analysis.TokenCounts[token] > 0) used.push_back(token);
+        }
+        std::stable_sort(used.begin(), used.end(), [&](size_t a, size_t b) { return analysis.TokenCounts[a] > analysis.TokenCounts[b]; });
+        bool first = true;
+        for (size_t token : used) {
+            AppendField(json, std::string(DecodeTable[token]).c_str(), analysis.TokenCounts[token], first);
+        }
+        json += "}";
+    }
+
+    std::string FormatAnalysisJson(const std::string& tool, const std::string& version, const std::vector<AnalysisEntry>& entries) {
+        std::string json = "{\n  \"tool\": ";
+        AppendJsonString(json, tool);
+        json += ",\n  \"version\": ";
+        AppendJsonString(json, version);
+        json += ",\n  \"files\": [";
+
+        ProgramAnalysis totals;
+        uint64_t lines = 0;
+        uint64_t failed = 0;
+        for (size_t n = 0; n < entries.size(); n++) {
+            const AnalysisEntry& entry = entries[n];
+            json += n == 0 ? "\n    {" : ",\n    {";
+            json += "\"input\": ";
+            AppendJsonString(json, entry.Input);
+            json += ", \"success\": ";
+            json += entry.Success ? "true" : "false";
+            if (!entry.Success) {
+                json += ", \"error\": ";
+                AppendJsonString(json, entry.Error);
+                failed++;
+            }
+            AppendWarnings(json, entry.Warnings);
+            if (entry.Success) {
+                const ProgramAnalysis& analysis = entry.Analysis;
+                AppendAnalysis(json, analysis, "     ");
+                json += ",\n     \"lines\": [";
+                for (size_t l = 0; l < analysis.Lines.size(); l++) {
+                    const LineSize& line = analysis.Lines[l];
+                    json += l == 0 ? "\n       {\"line\": " : ",\n       {\"line\": ";
+                    json += std::to_string(line.Number) + ", \"bytes\": ";
+                    AppendBreakdown(json, line.Bytes);
+                    json += "}";
+                }
+                json += analysis.Lines.empty() ? "]" : "\n     ]";
+                totals.Add(analysis);
+                lines += analysis.Lines.size();
+            }
+            json += "}";
+        }
+
+        json += entries.empty() ? "],\n" : "\n  ],\n";
+        json += "  \"totals\": {\"files\": " + std::to_string(entries.size()) + ", \"failed\": " + std::to_string(failed) +
+                ", \"lines\": " + std::to_string(lines);
+        AppendAnalysis(json, totals, "   ");
+        json += "}\n}\n";
+        return json;
+    }
+
+    void WriteStatsReport(const StatsOptions& options, const std::string& json, std::ostream& fallback) {
+        if (options.Path.empty()) {
+            fallback << json;
+            return;
+        }
+
+        std::ofstream out(options.Path, std::ios::binary);
+        if (!out.is_open()) throw std::runtime_error("Could not write stats to " + options.Path);
+        out << json;
+    }
+
+} // namespace speccybasic
@@ -0,0 +1,68 @@
+#ifndef SPECCYBASIC_PROFILE_H
+#define SPECCYBASIC_PROFILE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "analyze.h"
+#include "diagnostics.h"
+#include "stats.h"
+
+// --stats / --profile / --analyze reporting for the CLIs. Not part of the library: profile.cpp replaces the global
+// operator new to count allocations, which only an executable should do.
+namespace speccybasic {
+
+    struct StatsOptions {
+        bool Enabled = false;
+        bool Profile = false;
+        std::string Path; // Empty writes the report where the status line would have gone
+    };
+
+    // One converted file as it appears in the report
+    struct StatsEntry {
+        std::string Input;
+        std::string Output;
+        bool Success = false;
+        std::string Error;
+        Diagnostics Warnings;
+        uint64_t TotalNs = 0;
+        ConversionStats Stats;
+    };
+
+    // One program in the --analyze report
+    struct AnalysisEntry {
+        std::string Input;
+        bool Success = false;
+        std::string Error;
+        Diagnostics Warnings;
+        ProgramAnalysis Analysis;
+    };
+
+    // Calls to operator new since the program started
+    uint64_t AllocationCount();
+
+    // Peak resident set size of this process in bytes, or 0 where the platform cannot tell
+    uint64_t PeakRssBytes();
+
+    // Takes --stats[=FILE] and --profile[=FILE]; false for any other argument
+    bool ParseStatsArgument(const std::string& arg, StatsOptions& options);
+    // Takes --analyze[=FILE], filling in where the report goes as for --stats
+    bool ParseAnalyzeArgument(const std::string& arg, StatsOptions& options);
+
+    // The JSON report: per-file phase times and counters, then process-wide allocations and peak RSS.
+    // tool picks the phase names ("txt2bas" or "bas2txt").
+    std::string FormatStatsJson(const std::string& tool, const std::string& version, const std::vector<StatsEntry>& entries,
+                                uint64_t allocations, uint64_t totalNs, bool profile);
+
+    // The --analyze report: for each program its byte breakdown, token counts, savings estimates and
+    // line sizes, then the same totalled over every program that could be read
+    std::string FormatAnalysisJson(const std::string& tool, const std::string& version, const std::vector<AnalysisEntry>& entries);
+
+    // Writes the report to options.Path, or to fallback when no path was given
+    void WriteStatsReport(const StatsOptions& options, const std::string& json, std::ostream& fallback);
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_PROFILE_H
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "scan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPECCYBASIC_SCAN_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SPECCYBASIC_SCAN_AVX2 1 // Built with a target attribute, used only when the CPU reports it
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SPECCYBASIC_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace speccybasic {
+
+    size_t FindAnyOfScalar(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        for (size_t i = 0; i < size; i++) {
+            uint8_t byte = data[i];
+            if (byte == a || byte == b || byte == c || byte == d) return i;
+        }
+        return size;
+    }
+
+#if defined(SPECCYBASIC_SCAN_SSE2) || defined(SPECCYBASIC_SCAN_NEON)
+    static inline unsigned CountTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER) && defined(_M_IX86)
+        unsigned long index;
+        _BitScanForward(&index, static_cast<unsigned long>(mask)); // x86 masks are at most 32 bits
+        return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+    }
+#endif
+
+#ifdef SPECCYBASIC_SCAN_SSE2
+    static size_t FindAnyOfSse2(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        const __m128i va = _mm_set1_epi8(static_cast<char>(a));
+        const __m128i vb = _mm_set1_epi8(static_cast<char>(b));
+        const __m128i vc = _mm_set1_epi8(static_cast<char>(c));
+        const __m128i vd = _mm_set1_epi8(static_cast<char>(d));
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, vc), _mm_cmpeq_epi8(chunk, vd)));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        return i + FindAnyOfScalar(data + i, size - i, a, b, c, d);
+    }
+#endif
+
+#ifdef SPECCYBASIC_SCAN_AVX2
+    __attribute__((target("avx2")))
+    static size_t FindAnyOfAvx2(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        const __m256i va = _mm256_set1_epi8(static_cast<char>(a));
+        const __m256i vb = _mm256_set1_epi8(static_cast<char>(b));
+        const __m256i vc = _mm256_set1_epi8(static_cast<char>(c));
+        const __m256i vd = _mm256_set1_epi8(static_cast<char>(d));
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb)),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(chunk, vc), _mm256_cmpeq_epi8(chunk, vd)));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+            if (mask) return i + CountTrailingZeros(mask);
+        }
+        // The tail is short enough that one SSE2 pass and the scalar remainder cost about the same
+        return i + FindAnyOfSse2(data + i, size - i, a, b, c, d);
+    }
+#endif
+
+#ifdef SPECCYBASIC_SCAN_NEON
+    static size_t FindAnyOfNeon(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        const uint8x16_t va = vdupq_n_u8(a);
+        const uint8x16_t vb = vdupq_n_u8(b);
+        const uint8x16_t vc = vdupq_n_u8(c);
+        const uint8x16_t vd = vdupq_n_u8(d);
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            uint8x16_t chunk = vld1q_u8(data + i);
+            uint8x16_t hits = vorrq_u8(vorrq_u8(vceqq_u8(chunk, va), vceqq_u8(chunk, vb)),
+                                       vorrq_u8(vceqq_u8(chunk, vc), vceqq_u8(chunk, vd)));
+            // Narrow each byte to a nibble so the 16 results fit one 64-bit mask
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+            if (mask) return i + CountTrailingZeros(mask) / 4;
+        }
+        return i + FindAnyOfScalar(data + i, size - i, a, b, c, d);
+    }
+#endif
+
+    static FindAnyOfFunction SelectFindAnyOf() {
+#if defined(SPECCYBASIC_SCAN_AVX2)
+        if (__builtin_cpu_supports("avx2")) return FindAnyOfAvx2;
+#endif
+#if defined(SPECCYBASIC_SCAN_SSE2)
+        return FindAnyOfSse2;
+#elif defined(SPECCYBASIC_SCAN_NEON)
+        return FindAnyOfNeon;
+#else
+        return FindAnyOfScalar;
+#endif
+    }
+
+    // Stands in until the first call, then swaps in the real scanner so later calls skip the check
+    static size_t ResolveFindAnyOf(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        FindAnyOfFunction selected = SelectFindAnyOf();
+        ActiveFindAnyOf.store(selected, std::memory_order_relaxed);
+        return selected(data, size, a, b, c, d);
+    }
+
+    std::atomic<FindAnyOfFunction> ActiveFindAnyOf{ ResolveFindAnyOf };
+
+    const char* ScannerName() {
+        FindAnyOfFunction selected = SelectFindAnyOf();
+#if defined(SPECCYBASIC_SCAN_AVX2)
+        if (selected == FindAnyOfAvx2) return "avx2";
+#endif
+#if defined(SPECCYBASIC_SCAN_SSE2)
+        if (selected == FindAnyOfSse2) return "sse2";
+#elif defined(SPECCYBASIC_SCAN_NEON)
+        if (selected == FindAnyOfNeon) return "neon";
+#endif
+        return "scalar";
+    }
+
+} // namespace speccybasic
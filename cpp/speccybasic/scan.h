@@ -0,0 +1,37 @@
+#ifndef SPECCYBASIC_SCAN_H
+#define SPECCYBASIC_SCAN_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Delimiter scanning for the long literal runs in strings, REMs, comments and dot commands
+namespace speccybasic {
+
+    using FindAnyOfFunction = size_t (*)(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+
+    // The scanner picked for this CPU (AVX2, SSE2, NEON or scalar); resolved on the first call
+    extern std::atomic<FindAnyOfFunction> ActiveFindAnyOf;
+
+    // Offset of the first byte in [data, data + size) equal to a, b, c or d, or size when there is none.
+    // Repeat a byte to look for fewer than four. The first 16 bytes are checked inline, since most
+    // strings are only a few characters and the call would cost more than the scan.
+    inline size_t FindAnyOf(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        size_t head = size < 16 ? size : 16;
+        for (size_t i = 0; i < head; i++) {
+            uint8_t byte = data[i];
+            if (byte == a || byte == b || byte == c || byte == d) return i;
+        }
+        if (head == size) return size;
+        return head + ActiveFindAnyOf.load(std::memory_order_relaxed)(data + head, size - head, a, b, c, d);
+    }
+
+    // The byte-at-a-time version every other scanner must agree with
+    size_t FindAnyOfScalar(const uint8_t* data, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+
+    // Name of the scanner in use: "avx2", "sse2", "neon" or "scalar"
+    const char* ScannerName();
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_SCAN_H
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "speccybasic.h"
+#include "bas2txt.h"
+#include "txt2bas.h"
+#include "tokens.h"
+#include <algorithm>
+#include <cctype>
+
+namespace speccybasic {
+
+    // Both converters are stateless, so every caller can share these
+    static const txt2bas::BasConverter Converter;
+    static const bas2txt::BasParser Parser;
+
+    std::vector<uint8_t> Tokenize(std::string_view text) {
+        return Converter.Convert(text).FileData;
+    }
+
+    std::vector<uint8_t> Tokenize(std::string_view text, txt2bas::LineCache& cache) {
+        return Converter.Convert(text, nullptr, &cache).FileData;
+    }
+
+    std::string Detokenize(const uint8_t* data, size_t size) {
+        std::string text;
+        Parser.Parse(data, size, text);
+        return text;
+    }
+
+    std::string Detokenize(const std::vector<uint8_t>& data) {
+        return Detokenize(data.data(), data.size());
+    }
+
+    static bool IsWordChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // Keywords become their token byte (an IF with no THEN after it being the block IF, 0x83, as txt2bas
+    // codes it), REM text is kept as it stands, and spaces outside strings go. The decoder shows 0x60 and
+    // 0x7F as £ and ©, so those are folded back.
+    static std::string NormalizeLine(std::string_view text) {
+        auto isThen = [&text](size_t at) {
+            for (size_t k = 0; k < 4; k++) {
+                if (std::toupper(static_cast<unsigned char>(text[at + k])) != "THEN"[k]) return false;
+            }
+            return (at == 0 || !IsWordChar(text[at - 1])) && (at + 4 == text.size() || !IsWordChar(text[at + 4]));
+        };
+        size_t lastThen = std::string_view::npos;
+        for (size_t p = text.size(); p >= 4 && lastThen == std::string_view::npos; p--) {
+            if (isThen(p - 4)) lastThen = p - 4;
+        }
+
+        std::string out;
+        bool inString = false;
+        for (size_t i = 0; i < text.size(); ) {
+            if (text.compare(i, 2, "\xC2\xA3") == 0 || text.compare(i, 2, "\xC2\xA9") == 0) {
+                out += (text[i + 1] == '\xA3') ? '\x60' : '\x7F';
+                i += 2;
+                continue;
+            }
+            char c = text[i];
+            if (c == '"') inString = !inString;
+            if (inString || c == '"') {
+                out += c;
+                i++;
+                continue;
+            }
+            if (c == ' ' || c == '\t') {
+                i++;
+                continue;
+            }
+
+            std::string_view keyword;
+            uint8_t token;
+            if (!Keywords.Match(text, i, keyword, token)) {
+                out += c;
+                i++;
+                continue;
+            }
+            if (token == 0xFA && !(lastThen != std::string_view::npos && lastThen > i)) token = 0x83;
+            out += static_cast<char>(token);
+            i += keyword.size();
+            if (TokenAttributes[token] & RestOfLine) {
+                for (; i < text.size(); i++) {
+                    if (text[i] != ' ') out += text[i];
+                }
+            }
+        }
+        return out;
+    }
+
+    VerifyResult Verify(std::string_view source, const uint8_t* program, size_t size) {
+        std::string listing = Detokenize(program, size);
+        std::vector<txt2bas::SourceLine> expected, decoded;
+        txt2bas::SplitListing(source, expected);
+        txt2bas::SplitListing(listing, decoded);
+
+        VerifyResult result;
+        for (size_t n = 0; n < std::max(expected.size(), decoded.size()); n++) {
+            const txt2bas::SourceLine* want = n < expected.size() ? &expected[n] : nullptr;
+            const txt2bas::SourceLine* got = n < decoded.size() ? &decoded[n] : nullptr;
+            if (want && got && want->LineNum == got->LineNum && NormalizeLine(want->Text) == NormalizeLine(got->Text)) continue;
+
+            result.Matches = false;
+            result.LineNumber = want ? want->LineNum : got->LineNum;
+            if (want) result.Source = std::to_string(want->LineNum) + " " + std::string(want->Text);
+            if (got) result.Decoded = std::to_string(got->LineNum) + " " + std::string(got->Text);
+            break;
+        }
+        return result;
+    }
+
+} // namespace speccybasic
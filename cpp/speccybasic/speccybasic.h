@@ -0,0 +1,42 @@
+#ifndef SPECCYBASIC_H
+#define SPECCYBASIC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "linecache.h"
+
+// Buffer-in/buffer-out API for embedding the converters in other programs. Nothing behind it opens
+// files or uses iostreams; malformed input is reported with std::runtime_error, as in the CLIs.
+namespace speccybasic {
+
+    // Tokenizes a text listing into a complete +3DOS .bas image (128-byte header first)
+    std::vector<uint8_t> Tokenize(std::string_view text);
+    // Same output, but only lines that are new or changed since the last call with this cache are
+    // tokenized; suits re-converting a listing after small edits
+    std::vector<uint8_t> Tokenize(std::string_view text, txt2bas::LineCache& cache);
+
+    // Decodes a .bas image, with or without its +3DOS header, back into a text listing
+    std::string Detokenize(const uint8_t* data, size_t size);
+    std::string Detokenize(const std::vector<uint8_t>& data);
+
+    // The first line where a program and the listing it was made from disagree
+    struct VerifyResult {
+        bool Matches = true;
+        int LineNumber = -1;
+        std::string Source;  // The listing's line, numbered as txt2bas reads it (empty if the program has an extra line)
+        std::string Decoded; // The line as decoded from the program (empty if it is missing)
+    };
+
+    // Decodes a program (in any container bas2txt reads) and compares it with its source listing line
+    // by line. Both sides are normalized first: keywords by token rather than spelling, case or alias,
+    // and spaces outside strings dropped, so what is left are differences a tokenizer or decoder bug
+    // would make.
+    VerifyResult Verify(std::string_view source, const uint8_t* program, size_t size);
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_H
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef SPECCYBASIC_STATS_H
+#define SPECCYBASIC_STATS_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace speccybasic {
+
+    // Where one conversion spent its time (nanoseconds) and what it produced. The converters only fill
+    // it in when handed one. Profile also times the tokenizer's inner steps, which costs a clock read
+    // per keyword, number and literal, so it is left off for plain counters.
+    struct ConversionStats {
+        bool Profile = false;
+
+        // Both tools
+        uint64_t ReadNs = 0;
+        uint64_t WriteNs = 0;
+
+        // txt2bas
+        uint64_t SplitNs = 0;
+        uint64_t TokenizeNs = 0;
+        uint64_t KeywordNs = 0; // Profile only, like the two below
+        uint64_t NumberNs = 0;
+        uint64_t CopyNs = 0;
+        uint64_t VerifyNs = 0; // --verify only
+        uint64_t OptimizeNs = 0; // --optimize only
+
+        // bas2txt
+        uint64_t HeaderNs = 0;
+        uint64_t DecodeNs = 0;
+
+        uint64_t Lines = 0;
+        uint64_t Tokens = 0;
+        uint64_t Numbers = 0;
+        uint64_t InputBytes = 0;
+        uint64_t OutputBytes = 0;
+        uint64_t SavedBytes = 0; // txt2bas --optimize only
+
+        // txt2bas with a line cache
+        uint64_t CacheHits = 0;
+        uint64_t CacheMisses = 0;
+
+        // Folds in what a parallel chunk counted; phase times are taken around the whole run instead
+        void AddTokenizerCounts(const ConversionStats& chunk) {
+            KeywordNs += chunk.KeywordNs;
+            NumberNs += chunk.NumberNs;
+            CopyNs += chunk.CopyNs;
+            Tokens += chunk.Tokens;
+            Numbers += chunk.Numbers;
+        }
+    };
+
+    // Adds the time between construction and destruction to *target. With a null target the clock is
+    // never read, so disabled stats cost one branch.
+    class ScopedTimer {
+    private:
+        uint64_t* _target;
+        std::chrono::steady_clock::time_point _start;
+
+    public:
+        explicit ScopedTimer(uint64_t* target) : _target(target) {
+            if (_target) _start = std::chrono::steady_clock::now();
+        }
+
+        ~ScopedTimer() { Stop(); }
+
+        // Records the time so far and disarms the timer, for phases that end before their scope does
+        void Stop() {
+            if (_target) {
+                auto elapsed = std::chrono::steady_clock::now() - _start;
+                *_target += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+                _target = nullptr;
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_STATS_H
\ No newline at end of file
@@ -0,0 +1,239 @@
+#ifndef SPECCYBASIC_TOKENS_H
+#define SPECCYBASIC_TOKENS_H
+
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+// Single source of truth for the ZX Spectrum / NextBASIC token set, shared by txt2bas and bas2txt.
+// Everything here is built at compile time, so neither tool allocates to get at its tables.
+namespace speccybasic {
+
+    struct Keyword {
+        std::string_view Text;
+        uint8_t Token;
+        bool Alias = false; // Accepted by txt2bas but never printed by bas2txt
+    };
+
+    // 0x81-0xA2 are the ZX Spectrum Next extensions, 0xA3-0xFF standard Sinclair BASIC
+    inline constexpr std::array<Keyword, 131> KeywordTable = {{
+        {"TIME", 0x81}, {"PRIVATE", 0x82}, {"ELSE IF", 0x83}, {"ENDIF", 0x84},
+        {"EXIT", 0x85}, {"REF", 0x86}, {"PEEK$", 0x87}, {"REG", 0x88},
+        {"DPOKE", 0x89}, {"DPEEK", 0x8A}, {"MOD", 0x8B}, {"<<", 0x8C},
+        {">>", 0x8D}, {"UNTIL", 0x8E}, {"ERROR", 0x8F}, {"ON", 0x90},
+        {"DEFPROC", 0x91}, {"ENDPROC", 0x92}, {"PROC", 0x93}, {"LOCAL", 0x94},
+        {"DRIVER", 0x95}, {"WHILE", 0x96}, {"REPEAT", 0x97}, {"ELSE", 0x98},
+        {"REMOUNT", 0x99}, {"BANK", 0x9A}, {"TILE", 0x9B}, {"LAYER", 0x9C},
+        {"PALETTE", 0x9D}, {"SPRITE", 0x9E}, {"PWD", 0x9F}, {"CD", 0xA0},
+        {"MKDIR", 0xA1}, {"RMDIR", 0xA2}, {"SPECTRUM", 0xA3}, {"PLAY", 0xA4},
+        {"RND", 0xA5}, {"INKEY$", 0xA6}, {"PI", 0xA7}, {"FN", 0xA8},
+        {"POINT", 0xA9}, {"SCREEN$", 0xAA}, {"ATTR", 0xAB}, {"AT", 0xAC},
+        {"TAB", 0xAD}, {"VAL$", 0xAE}, {"CODE", 0xAF}, {"VAL", 0xB0},
+        {"LEN", 0xB1}, {"SIN", 0xB2}, {"COS", 0xB3}, {"TAN", 0xB4},
+        {"ASN", 0xB5}, {"ACS", 0xB6}, {"ATN", 0xB7}, {"LN", 0xB8},
+        {"EXP", 0xB9}, {"INT", 0xBA}, {"SQR", 0xBB}, {"SGN", 0xBC},
+        {"ABS", 0xBD}, {"PEEK", 0xBE}, {"IN", 0xBF}, {"USR", 0xC0},
+        {"STR$", 0xC1}, {"CHR$", 0xC2}, {"NOT", 0xC3}, {"BIN", 0xC4},
+        {"OR", 0xC5}, {"AND", 0xC6}, {"<=", 0xC7}, {">=", 0xC8},
+        {"<>", 0xC9}, {"LINE", 0xCA}, {"THEN", 0xCB}, {"TO", 0xCC},
+        {"STEP", 0xCD}, {"DEF FN", 0xCE}, {"CAT", 0xCF}, {"FORMAT", 0xD0},
+        {"MOVE", 0xD1}, {"ERASE", 0xD2}, {"OPEN #", 0xD3}, {"CLOSE #", 0xD4},
+        {"MERGE", 0xD5}, {"VERIFY", 0xD6}, {"BEEP", 0xD7}, {"CIRCLE", 0xD8},
+        {"INK", 0xD9}, {"PAPER", 0xDA}, {"FLASH", 0xDB}, {"BRIGHT", 0xDC},
+        {"INVERSE", 0xDD}, {"OVER", 0xDE}, {"OUT", 0xDF}, {"LPRINT", 0xE0},
+        {"LLIST", 0xE1}, {"STOP", 0xE2}, {"READ", 0xE3}, {"DATA", 0xE4},
+        {"RESTORE", 0xE5}, {"NEW", 0xE6}, {"BORDER", 0xE7}, {"CONTINUE", 0xE8},
+        {"CONT", 0xE8, true}, {"DIM", 0xE9}, {"REM", 0xEA}, {"FOR", 0xEB},
+        {"GO TO", 0xEC}, {"GOTO", 0xEC, true}, {"GO SUB", 0xED}, {"GOSUB", 0xED, true},
+        {"INPUT", 0xEE}, {"LOAD", 0xEF}, {"LIST", 0xF0}, {"LET", 0xF1},
+        {"PAUSE", 0xF2}, {"NEXT", 0xF3}, {"POKE", 0xF4}, {"PRINT", 0xF5},
+        {"PLOT", 0xF6}, {"RUN", 0xF7}, {"SAVE", 0xF8}, {"RANDOMIZE", 0xF9},
+        {"RAND", 0xF9, true}, {"IF", 0xFA}, {"CLS", 0xFB}, {"DRAW", 0xFC},
+        {"CLEAR", 0xFD}, {"RETURN", 0xFE}, {"COPY", 0xFF}
+    }};
+
+    namespace detail {
+        constexpr unsigned char Upper(char ch) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            return (c >= 'a' && c <= 'z') ? static_cast<unsigned char>(c - 'a' + 'A') : c;
+        }
+
+        constexpr std::array<std::string_view, 256> BuildDecodeTable() {
+            std::array<std::string_view, 256> table{};
+            for (const Keyword& kw : KeywordTable) {
+                if (!kw.Alias) table[kw.Token] = kw.Text;
+            }
+            return table;
+        }
+
+        constexpr bool TableIsConsistent() {
+            std::array<int, 256> spellings{};
+            for (const Keyword& kw : KeywordTable) {
+                if (kw.Token < 0x81 || kw.Text.empty()) return false;
+                if (!kw.Alias) spellings[kw.Token]++;
+            }
+            for (const Keyword& kw : KeywordTable) {
+                if (spellings[kw.Token] != 1) return false;
+            }
+            return true;
+        }
+
+        constexpr size_t CountKeywordChars() {
+            size_t total = 0;
+            for (const Keyword& kw : KeywordTable) total += kw.Text.length();
+            return total;
+        }
+
+        constexpr size_t CountCharClasses() {
+            std::array<bool, 256> seen{};
+            size_t count = 0;
+            for (const Keyword& kw : KeywordTable) {
+                for (char ch : kw.Text) {
+                    if (!seen[Upper(ch)]) { seen[Upper(ch)] = true; count++; }
+                }
+            }
+            return count;
+        }
+    } // namespace detail
+
+    static_assert(detail::TableIsConsistent(), "Every token needs exactly one canonical spelling");
+
+    // Token byte -> canonical keyword; an empty view means the byte is not a token
+    inline constexpr std::array<std::string_view, 256> DecodeTable = detail::BuildDecodeTable();
+
+    // Bits of TokenAttributes: what the tokenizer and decoder decide per token, as one load and a mask
+    enum TokenAttribute : uint16_t {
+        IsToken            = 1 << 0, // Has a keyword to print
+        IntOperator        = 1 << 1, // Keeps a NextBASIC integer expression running...
+        IntFunction        = 1 << 2, // ...as do the functions one may call
+        OpensIf            = 1 << 3, // IF and ELSE IF
+        ClosesIf           = 1 << 4, // THEN and ENDIF, which also end an integer expression
+        OpensUntil         = 1 << 5,
+        CommandFollows     = 1 << 6, // THEN and ELSE, after which a dot command may appear
+        RestOfLine         = 1 << 7, // REM: everything after it is copied as it stands
+        // Bytes (tokens or not) after which a % starts an integer statement, or a ; starts a comment
+        StartsIntStatement = 1 << 8,
+        StartsComment      = 1 << 9,
+    };
+
+    namespace detail {
+        constexpr void MarkKeywords(std::array<uint16_t, 256>& table, std::initializer_list<std::string_view> texts, uint16_t bits) {
+            for (const Keyword& kw : KeywordTable) {
+                for (std::string_view text : texts) {
+                    if (kw.Text == text) table[kw.Token] |= bits;
+                }
+            }
+        }
+
+        constexpr std::array<uint16_t, 256> BuildTokenAttributes() {
+            std::array<uint16_t, 256> table{};
+            for (const Keyword& kw : KeywordTable) table[kw.Token] |= IsToken;
+            // The JS operator list also has the single-character operators, but those are never tokens
+            MarkKeywords(table, { "AND", "OR", "NOT", "MOD", "<=", ">=", "<>", "<<", ">>" }, IntOperator);
+            MarkKeywords(table, { "IN", "REG", "PEEK", "DPEEK", "USR", "BIN", "RND", "BANK", "SPRITE", "INT", "ABS",
+                                  "SGN", "CODE" }, IntFunction);
+            MarkKeywords(table, { "IF", "ELSE IF" }, OpensIf);
+            MarkKeywords(table, { "THEN", "ENDIF" }, ClosesIf);
+            MarkKeywords(table, { "UNTIL" }, OpensUntil);
+            MarkKeywords(table, { "THEN", "ELSE" }, CommandFollows);
+            MarkKeywords(table, { "REM" }, RestOfLine);
+            MarkKeywords(table, { "ERROR", "IF", "ELSE IF", "ELSE", "UNTIL", "DEF FN" }, StartsIntStatement);
+            MarkKeywords(table, { "ERROR", "THEN", "ELSE" }, StartsComment);
+            table[':'] |= StartsIntStatement | StartsComment;
+            table['='] |= StartsIntStatement;
+            return table;
+        }
+    } // namespace detail
+
+    // Every byte value's TokenAttribute bits; plain characters have none, except ':' and '='
+    inline constexpr std::array<uint16_t, 256> TokenAttributes = detail::BuildTokenAttributes();
+
+    // Case-folded trie over KeywordTable. Match() finds the longest keyword starting at a
+    // position that also satisfies the alpha-boundary rules.
+    class KeywordMatcher {
+    public:
+        static constexpr size_t MaxKeywordLength = 16;
+
+        constexpr KeywordMatcher() {
+            // Class 0 means "cannot appear in any keyword"; letters fold onto one class
+            uint8_t classes = 1;
+            for (const Keyword& kw : KeywordTable) {
+                for (char ch : kw.Text) {
+                    unsigned char c = detail::Upper(ch);
+                    if (_charClass[c] == 0) {
+                        _charClass[c] = classes;
+                        if (c >= 'A' && c <= 'Z') _charClass[c - 'A' + 'a'] = classes;
+                        classes++;
+                    }
+                }
+            }
+
+            // Node 0 is the root; a zero transition means "no child"
+            uint16_t nodes = 1;
+            for (size_t k = 0; k < KeywordTable.size(); k++) {
+                size_t node = 0;
+                for (char ch : KeywordTable[k].Text) {
+                    size_t slot = node * ClassCount + _charClass[detail::Upper(ch)];
+                    if (_next[slot] == 0) _next[slot] = nodes++;
+                    node = _next[slot];
+                }
+                _keyword[node] = static_cast<uint8_t>(k + 1);
+            }
+        }
+
+        bool Match(std::string_view text, size_t pos, std::string_view& key, uint8_t& token) const {
+            // Every keyword ending along the walked path, shortest first
+            std::array<uint8_t, MaxKeywordLength> found{};
+            size_t foundCount = 0;
+
+            size_t node = 0;
+            for (size_t j = pos; j < text.length() && foundCount < MaxKeywordLength; j++) {
+                uint8_t cls = _charClass[static_cast<unsigned char>(text[j])];
+                if (cls == 0) break;
+                node = _next[node * ClassCount + cls];
+                if (node == 0) break;
+                if (_keyword[node] != 0) found[foundCount++] = _keyword[node];
+            }
+
+            // Longest candidate wins unless it would split an identifier, then retry shorter ones
+            while (foundCount > 0) {
+                const Keyword& kw = KeywordTable[found[--foundCount] - 1];
+                std::string_view k = kw.Text;
+
+                if (std::isalpha(static_cast<unsigned char>(k[0])) && pos > 0) {
+                    char p = text[pos - 1];
+                    if (std::isalnum(static_cast<unsigned char>(p)) || p == '_') return false;
+                }
+
+                if (std::isalpha(static_cast<unsigned char>(k.back()))) {
+                    size_t next = pos + k.length();
+                    if (next < text.length()) {
+                        char n = text[next];
+                        if (std::isalnum(static_cast<unsigned char>(n)) || n == '_') continue;
+                    }
+                }
+
+                key = k;
+                token = kw.Token;
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        static constexpr size_t ClassCount = detail::CountCharClasses() + 1;
+        static constexpr size_t NodeCount = detail::CountKeywordChars() + 1;
+
+        std::array<uint8_t, 256> _charClass{};
+        std::array<uint16_t, NodeCount * ClassCount> _next{};
+        std::array<uint8_t, NodeCount> _keyword{}; // KeywordTable index + 1, 0 when no keyword ends here
+    };
+
+    inline constexpr KeywordMatcher Keywords{};
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_TOKENS_H
\ No newline at end of file
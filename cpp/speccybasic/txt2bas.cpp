@@ -0,0 +1,1008 @@
+#include "txt2bas.h"
+#include "scan.h"
+#include "tokens.h"
+#include "workpool.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+
+namespace txt2bas {
+
+    std::vector<uint8_t> Plus3Dos::CreateHeader(int basicLength, int autoStartLine) {
+        std::vector<uint8_t> header(HeaderSize, 0);
+        WriteHeader(header.data(), basicLength, autoStartLine);
+        return header;
+    }
+
+    void Plus3Dos::WriteHeader(uint8_t* header, int basicLength, int autoStartLine) {
+        std::fill(header, header + HeaderSize, 0);
+
+        std::string_view sig = "PLUS3DOS";
+        std::copy(sig.begin(), sig.end(), header);
+        header[8] = 0x1A;
+        header[9] = 0x01;
+        header[10] = 0x00;
+
+        // Exactly mirrors headers.mjs initialization output logic which doesn't subtract 128 natively from length
+        int lengthField = basicLength + 128;
+        header[11] = static_cast<uint8_t>(lengthField & 0xFF);
+        header[12] = static_cast<uint8_t>((lengthField >> 8) & 0xFF);
+        header[13] = static_cast<uint8_t>((lengthField >> 16) & 0xFF);
+        header[14] = static_cast<uint8_t>((lengthField >> 24) & 0xFF);
+
+        header[15] = 0x00; // hType = 0 (BASIC)
+
+        int hFileLengthField = basicLength;
+        header[16] = static_cast<uint8_t>(hFileLengthField & 0xFF);
+        header[17] = static_cast<uint8_t>((hFileLengthField >> 8) & 0xFF);
+
+        if (autoStartLine >= 0 && autoStartLine < 32768) {
+            // JS unpack/pack DataView endianness bugs cancel each other out to output native Little-Endian
+            header[18] = static_cast<uint8_t>(autoStartLine & 0xFF);
+            header[19] = static_cast<uint8_t>((autoStartLine >> 8) & 0xFF);
+        } else {
+            // Default 32768 (0x8000) stored as little-endian
+            header[18] = 0x00;
+            header[19] = 0x80;
+        }
+
+        int hOffsetField = basicLength;
+        header[20] = static_cast<uint8_t>(hOffsetField & 0xFF);
+        header[21] = static_cast<uint8_t>((hOffsetField >> 8) & 0xFF);
+
+        int sum = 0;
+        for (int i = 0; i < 127; i++) sum += header[i];
+        header[127] = static_cast<uint8_t>(sum % 256);
+    }
+
+    static void PutWord(uint8_t* at, size_t value) {
+        at[0] = static_cast<uint8_t>(value & 0xFF);
+        at[1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+    }
+
+    static uint8_t XorChecksum(const uint8_t* begin, const uint8_t* end) {
+        uint8_t sum = 0;
+        for (const uint8_t* at = begin; at != end; at++) sum ^= *at;
+        return sum;
+    }
+
+    // The header block (flag to checksum) and the data block's flag, with the checksum behind the body
+    static void WriteTapeBlocks(uint8_t* header, uint8_t* dataFlag, size_t basicLength, int autoStartLine) {
+        // Tape lengths are 16-bit, and the data block's length field also counts its flag and checksum
+        if (basicLength > 0xFFFF - 2) throw std::runtime_error("Program too large for a tape block: " + std::to_string(basicLength) + " bytes");
+
+        header[0] = 0x00; // Header block
+        header[1] = 0x00; // Program
+        std::fill(header + 2, header + 2 + Tape::NameLength, ' ');
+        PutWord(header + 12, basicLength);
+        PutWord(header + 14, (autoStartLine >= 0 && autoStartLine < 32768) ? autoStartLine : 32768);
+        PutWord(header + 16, basicLength); // Variables start straight after the program
+        header[18] = XorChecksum(header, header + 18);
+
+        dataFlag[0] = 0xFF;
+        dataFlag[1 + basicLength] = XorChecksum(dataFlag, dataFlag + 1 + basicLength);
+    }
+
+    void Tape::WriteTap(uint8_t* file, size_t basicLength, int autoStartLine) {
+        PutWord(file, HeaderBlockSize);
+        PutWord(file + 2 + HeaderBlockSize, basicLength + 2);
+        WriteTapeBlocks(file + 2, file + TapPrefixSize - 1, basicLength, autoStartLine);
+    }
+
+    void Tape::WriteTzx(uint8_t* file, size_t basicLength, int autoStartLine) {
+        std::string_view sig = "ZXTape!\x1A";
+        std::copy(sig.begin(), sig.end(), file);
+        file[8] = 1; // Version 1.20
+        file[9] = 20;
+
+        // Standard-speed blocks, each followed by the usual one-second pause
+        uint8_t* block = file + 10;
+        block[0] = 0x10;
+        PutWord(block + 1, 1000);
+        PutWord(block + 3, HeaderBlockSize);
+        block += 5 + HeaderBlockSize;
+        block[0] = 0x10;
+        PutWord(block + 1, 1000);
+        PutWord(block + 3, basicLength + 2);
+        WriteTapeBlocks(file + 15, file + TzxPrefixSize - 1, basicLength, autoStartLine);
+    }
+
+    void Tape::SetName(uint8_t* headerBlock, std::string_view name) {
+        uint8_t* field = headerBlock + 2;
+        for (size_t i = 0; i < NameLength; i++) field[i] = (i < name.size()) ? static_cast<uint8_t>(name[i]) : ' ';
+        headerBlock[18] = XorChecksum(headerBlock, headerBlock + 18);
+    }
+
+    size_t ContainerPrefixSize(Container container) {
+        switch (container) {
+            case Container::Plus3Dos: return Plus3Dos::HeaderSize;
+            case Container::Tap: return Tape::TapPrefixSize;
+            case Container::Tzx: return Tape::TzxPrefixSize;
+            default: return 0;
+        }
+    }
+
+    size_t ContainerSuffixSize(Container container) {
+        return (container == Container::Tap || container == Container::Tzx) ? Tape::SuffixSize : 0;
+    }
+
+    void ConversionResult::SetName(std::string_view name) {
+        if (Format == Container::Tap) Tape::SetName(FileData.data() + 2, name);
+        else if (Format == Container::Tzx) Tape::SetName(FileData.data() + 15, name);
+    }
+
+    bool CaseInsensitiveEquals(std::string_view a, std::string_view b) {
+        if (a.length() != b.length()) return false;
+        return std::equal(a.begin(), a.end(), b.begin(), [](char c1, char c2) {
+            return std::toupper(static_cast<unsigned char>(c1)) == std::toupper(static_cast<unsigned char>(c2));
+        });
+    }
+
+    // Hand-written equivalent of matching R"(^\s*(\d{1,4})\s?(.*))": at most four digits form the
+    // line number, one whitespace after them is dropped, and '.' stops at any stray \r or \n.
+    static bool SplitLineNumber(std::string_view line, int& lineNum, std::string_view& rest) {
+        size_t pos = 0;
+        while (pos < line.length() && std::isspace(static_cast<unsigned char>(line[pos]))) pos++;
+
+        size_t digitsEnd = pos;
+        int value = 0;
+        while (digitsEnd < line.length() && digitsEnd - pos < 4 && std::isdigit(static_cast<unsigned char>(line[digitsEnd]))) {
+            value = value * 10 + (line[digitsEnd] - '0');
+            digitsEnd++;
+        }
+        if (digitsEnd == pos) return false;
+
+        size_t restStart = digitsEnd;
+        if (restStart < line.length() && std::isspace(static_cast<unsigned char>(line[restStart]))) restStart++;
+        size_t restEnd = line.find_first_of("\r\n", restStart);
+        if (restEnd == std::string_view::npos) restEnd = line.length();
+
+        lineNum = value;
+        rest = line.substr(restStart, restEnd - restStart);
+        return true;
+    }
+
+    // Reads the integer following the directive word, as `iss >> token >> value` used to
+    static bool ParseDirectiveNumber(std::string_view line, int& value) {
+        size_t pos = 0;
+        while (pos < line.length() && !std::isspace(static_cast<unsigned char>(line[pos]))) pos++;
+        while (pos < line.length() && std::isspace(static_cast<unsigned char>(line[pos]))) pos++;
+
+        if (pos < line.length() && line[pos] == '+') {
+            pos++;
+            if (pos >= line.length() || !std::isdigit(static_cast<unsigned char>(line[pos]))) return false;
+        }
+
+        int parsed = 0;
+        auto result = std::from_chars(line.data() + pos, line.data() + line.length(), parsed);
+        if (result.ec != std::errc()) return false;
+        value = parsed;
+        return true;
+    }
+
+    static bool IsWordChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // Position of the last whole-word, case-insensitive THEN in the line (npos if none).
+    // An IF has a THEN exactly when this lies beyond it, mirroring the old regex search to end of line.
+    static size_t FindLastThen(std::string_view text) {
+        for (size_t p = text.length(); p >= 4; p--) {
+            size_t start = p - 4;
+            if (!CaseInsensitiveEquals(text.substr(start, 4), "THEN")) continue;
+            if (start > 0 && IsWordChar(text[start - 1])) continue;
+            if (p < text.length() && IsWordChar(text[p])) continue;
+            return start;
+        }
+        return std::string_view::npos;
+    }
+
+    void SplitListing(std::string_view source, std::vector<SourceLine>& numbered, int* autoStartLine) {
+        numbered.clear();
+
+        // Exact match of index.mjs text.split(text.includes('\r') ? '\r' : '\n')
+        // to securely segment Classic Mac \r files vs modern \n files without ignoring content.
+        char delimiter = source.find('\r') != std::string_view::npos ? '\r' : '\n';
+        int currentLineNum = 10;
+        size_t start = 0;
+        while (start <= source.length()) {
+            size_t end = source.find(delimiter, start);
+            if (end == std::string_view::npos) end = source.length();
+            std::string_view line = source.substr(start, end - start);
+            start = end + 1;
+
+            size_t first = line.find_first_not_of(" \t\r\n");
+            if (first == std::string_view::npos) continue;
+            line.remove_prefix(first);
+            line.remove_suffix(line.length() - line.find_last_not_of(" \t\r\n") - 1);
+
+            if (line[0] == '#') {
+                if (CaseInsensitiveEquals(line.substr(0, 10), "#autostart")) {
+                    int autoStartVal;
+                    if (autoStartLine && ParseDirectiveNumber(line, autoStartVal)) *autoStartLine = autoStartVal;
+                }
+                continue;
+            }
+
+            int lineNum = currentLineNum;
+            std::string_view restOfLine = line;
+
+            if (SplitLineNumber(line, lineNum, restOfLine)) {
+                currentLineNum = lineNum + 10;
+            } else {
+                currentLineNum += 10;
+            }
+
+            numbered.push_back({lineNum, restOfLine});
+        }
+    }
+
+    // The numbering pass's working array. Each thread keeps one and only clears it between files, so
+    // batch and --watch runs stop going to the allocator for it once warmed up.
+    struct ConvertScratch {
+        std::vector<SourceLine> Numbered;
+
+        // Keeps a one-off huge listing from pinning its array for the life of the thread
+        static constexpr size_t RetainLines = 1 << 16;
+
+        void Release() {
+            if (Numbered.capacity() > RetainLines) std::vector<SourceLine>().swap(Numbered);
+        }
+    };
+
+    ConversionResult BasConverter::Convert(std::string_view source, speccybasic::ConversionStats* stats,
+                                           LineCache* cache, speccybasic::Diagnostics* diagnostics) const {
+        ConversionResult result;
+        result.Format = Format;
+        speccybasic::ScopedTimer splitTimer(stats ? &stats->SplitNs : nullptr);
+
+        // Every line below is a view into `source`; nothing is copied until it is tokenized
+        // Header slot first, lines stream in behind it, header is filled in last once #autostart is known
+        std::vector<uint8_t>& output = result.FileData;
+        size_t prefixSize = ContainerPrefixSize(Format);
+        output.reserve(prefixSize + source.size() + source.size() / 2 + Tape::SuffixSize);
+        output.resize(prefixSize);
+
+        static thread_local ConvertScratch scratch;
+        struct ReleaseOnExit {
+            ConvertScratch& Scratch;
+            ~ReleaseOnExit() { Scratch.Release(); }
+        } releaseOnExit{ scratch };
+
+        // Phase 1 (serial): directives and line numbering. Auto-numbering and #autostart are the only
+        // state carried from one line to the next, so once they are resolved every line stands alone.
+        std::vector<SourceLine>& numbered = scratch.Numbered;
+        SplitListing(source, numbered, &result.AutoStartLine);
+        splitTimer.Stop();
+        if (stats) {
+            stats->Lines += numbered.size();
+            stats->InputBytes += source.size();
+        }
+
+        // ParseLine is instantiated with and without counting, so plain conversions carry none of it, and
+        // with and without NextBASIC. `next` belongs to the caller's run of lines: in Auto mode it starts
+        // false and flips for good at the first line the 48K path gives up on, which is then redone.
+        auto parseLine = [this](const SourceLine& line, std::vector<uint8_t>& out, speccybasic::ConversionStats* counts,
+                                speccybasic::Diagnostics* found, bool& next) {
+            if (!next) {
+                size_t lineStart = out.size();
+                uint64_t tokens = counts ? counts->Tokens : 0;
+                uint64_t numbers = counts ? counts->Numbers : 0;
+                size_t foundBefore = found ? found->Items.size() : 0;
+                bool done = counts ? ParseLine<true, false>(line.LineNum, line.Text, out, counts, found)
+                                   : ParseLine<false, false>(line.LineNum, line.Text, out, nullptr, found);
+                if (done) return;
+                out.resize(lineStart);
+                if (counts) {
+                    counts->Tokens = tokens;
+                    counts->Numbers = numbers;
+                }
+                if (found) found->Items.resize(foundBefore);
+                next = true;
+            }
+            if (counts) ParseLine<true, true>(line.LineNum, line.Text, out, counts, found);
+            else ParseLine<false, true>(line.LineNum, line.Text, out, nullptr, found);
+        };
+        bool startNext = Language == Dialect::NextBasic;
+
+        // Phase 2: tokenize, in parallel for big listings, joining the chunks back in order
+        speccybasic::ScopedTimer tokenizeTimer(stats ? &stats->TokenizeNs : nullptr);
+        unsigned threads = speccybasic::ResolveThreadCount(LineThreads, numbered.size() / MinLinesPerChunk);
+        if (cache) {
+            // Line numbers are final by now, so a line whose number and text are unchanged tokenizes as before
+            // (in the same dialect)
+            uint8_t variant = Language == Dialect::Sinclair48K ? LineCache::Sinclair48KVariant : LineCache::NextBasicVariant;
+            size_t hits = cache->Hits;
+            size_t misses = cache->Misses;
+            bool next = startNext;
+            for (const SourceLine& line : numbered) {
+                if (const std::vector<uint8_t>* bytes = cache->Find(line.LineNum, line.Text, variant)) {
+                    output.insert(output.end(), bytes->begin(), bytes->end());
+                    continue;
+                }
+                size_t lineStart = output.size();
+                parseLine(line, output, stats, diagnostics, next);
+                cache->Store(line.LineNum, line.Text, output.data() + lineStart, output.size() - lineStart, variant);
+            }
+            cache->Prune();
+            if (stats) {
+                stats->CacheHits += cache->Hits - hits;
+                stats->CacheMisses += cache->Misses - misses;
+            }
+        } else if (threads <= 1 || numbered.size() < ParallelLineThreshold) {
+            bool next = startNext;
+            for (const SourceLine& line : numbered) parseLine(line, output, stats, diagnostics, next);
+        } else {
+            size_t chunkCount = std::min<size_t>(threads * 4, numbered.size() / MinLinesPerChunk);
+            std::vector<std::vector<uint8_t>> chunks(chunkCount);
+            std::vector<std::exception_ptr> errors(chunkCount);
+            std::vector<speccybasic::Diagnostics> chunkDiagnostics(diagnostics ? chunkCount : 0);
+
+            // Each chunk counts into its own copy; with profiling on, the inner times then add up to
+            // thread time rather than wall time
+            std::vector<speccybasic::ConversionStats> chunkStats(stats ? chunkCount : 0);
+            if (stats) {
+                for (auto& chunk : chunkStats) chunk.Profile = stats->Profile;
+            }
+
+            speccybasic::RunWorkStealing(chunkCount, threads, [&](size_t chunk, unsigned) {
+                size_t begin = chunk * numbered.size() / chunkCount;
+                size_t end = (chunk + 1) * numbered.size() / chunkCount;
+                try {
+                    chunks[chunk].reserve((end - begin) * (source.size() / numbered.size() + 8));
+                    speccybasic::ConversionStats* counts = stats ? &chunkStats[chunk] : nullptr;
+                    speccybasic::Diagnostics* found = diagnostics ? &chunkDiagnostics[chunk] : nullptr;
+                    bool next = startNext;
+                    for (size_t n = begin; n < end; n++) parseLine(numbered[n], chunks[chunk], counts, found, next);
+                } catch (...) {
+                    errors[chunk] = std::current_exception();
+                }
+            });
+
+            for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+                if (errors[chunk]) std::rethrow_exception(errors[chunk]);
+                output.insert(output.end(), chunks[chunk].begin(), chunks[chunk].end());
+                if (stats) stats->AddTokenizerCounts(chunkStats[chunk]);
+                if (diagnostics) diagnostics->Append(chunkDiagnostics[chunk]);
+            }
+        }
+        tokenizeTimer.Stop();
+
+        if (Optimize.Any()) {
+            speccybasic::ScopedTimer optimizeTimer(stats ? &stats->OptimizeNs : nullptr);
+            result.Saved = OptimizeProgram(output, prefixSize, Optimize, Language == Dialect::NextBasic);
+            if (stats) stats->SavedBytes += result.Saved.Total();
+        }
+
+        size_t basicLength = output.size() - prefixSize;
+        switch (Format) {
+            case Container::Plus3Dos:
+                Plus3Dos::WriteHeader(output.data(), static_cast<int>(basicLength), result.AutoStartLine);
+                break;
+            case Container::Tap:
+                output.resize(output.size() + Tape::SuffixSize);
+                Tape::WriteTap(output.data(), basicLength, result.AutoStartLine);
+                break;
+            case Container::Tzx:
+                output.resize(output.size() + Tape::SuffixSize);
+                Tape::WriteTzx(output.data(), basicLength, result.AutoStartLine);
+                break;
+            case Container::Raw:
+                break;
+        }
+        if (stats) stats->OutputBytes += output.size();
+        return result;
+    }
+
+    // Contexts ParseLine pushes while walking a line, as in the JS tokenizer's `in` stack
+    enum class Scope : uint8_t { StringExpression, OpenParens, DefFn, DefFnSig, DefFnArgs, Count };
+
+    // Fixed-capacity stack of Scope values with a per-scope count, so IsIn() is one lookup instead of a scan.
+    // Pathologically deep lines spill into an overflow vector rather than changing behaviour.
+    class ScopeStack {
+    private:
+        static constexpr size_t Capacity = 64;
+
+        std::array<Scope, Capacity> _items{};
+        std::vector<Scope> _overflow;
+        std::array<size_t, static_cast<size_t>(Scope::Count)> _counts{};
+        size_t _size = 0;
+
+        Scope Pop() {
+            _size--;
+            Scope top;
+            if (_size < Capacity) {
+                top = _items[_size];
+            } else {
+                top = _overflow.back();
+                _overflow.pop_back();
+            }
+            _counts[static_cast<size_t>(top)]--;
+            return top;
+        }
+
+    public:
+        void Push(Scope scope) {
+            if (_size < Capacity) _items[_size] = scope;
+            else _overflow.push_back(scope);
+            _size++;
+            _counts[static_cast<size_t>(scope)]++;
+        }
+
+        // Pops up to and including the nearest `scope`. REPLICATE JS BUG: with no such entry the whole stack goes.
+        void PopTo(Scope scope) {
+            if (!IsIn(scope)) {
+                Clear();
+                return;
+            }
+            while (Pop() != scope) {}
+        }
+
+        bool IsIn(Scope scope) const { return _counts[static_cast<size_t>(scope)] > 0; }
+
+        bool IsTop(Scope scope) const {
+            if (_size == 0) return false;
+            return (_size <= Capacity ? _items[_size - 1] : _overflow.back()) == scope;
+        }
+
+        void Clear() {
+            _size = 0;
+            _overflow.clear();
+            _counts.fill(0);
+        }
+    };
+
+    // A $hex or @binary literal, which only NextBASIC has; otherwise the symbol is a plain character
+    static bool StartsNextLiteral(std::string_view text, size_t i) {
+        if (i + 1 >= text.length()) return false;
+        char next = text[i + 1];
+        if (text[i] == '$') return std::isxdigit(static_cast<unsigned char>(next)) || next == '.';
+        return text[i] == '@' && (next == '0' || next == '1' || next == '.');
+    }
+
+    // Digits in `base` at the front of text, read as std::stoul did; false where it would have thrown,
+    // when there are none or they don't fit
+    static bool ReadUnsigned(std::string_view text, int base, unsigned long& value) {
+        return std::from_chars(text.data(), text.data() + text.length(), value, base).ec == std::errc();
+    }
+
+    // The value of a $hex or @binary literal's digits, fraction included. The fraction is scaled by its
+    // full length, stray dots and all, as the JS tool does.
+    static bool ReadRadixLiteral(std::string_view digits, int base, double& value) {
+        unsigned long whole;
+        size_t dotPos = digits.find('.');
+        if (dotPos == std::string_view::npos) {
+            if (!ReadUnsigned(digits, base, whole)) return false;
+            value = static_cast<double>(whole);
+            return true;
+        }
+        std::string_view frac = digits.substr(dotPos + 1);
+        if (!ReadUnsigned(digits.substr(0, dotPos), base, whole)) return false;
+        value = static_cast<double>(whole);
+        if (!frac.empty()) {
+            unsigned long fraction;
+            if (!ReadUnsigned(frac, base, fraction)) return false;
+            value += static_cast<double>(fraction) / std::pow(static_cast<double>(base), frac.length());
+        }
+        return true;
+    }
+
+    // A decimal literal's leading number, as std::stod read it: false where it would have thrown, which
+    // includes results too small to be normal doubles
+    static bool ReadDecimal(std::string_view text, double& value) {
+#if defined(__cpp_lib_to_chars)
+        double parsed = 0;
+        auto result = std::from_chars(text.data(), text.data() + text.length(), parsed);
+        if (result.ec != std::errc()) return false;
+#else
+        std::string copy(text);
+        char* end;
+        errno = 0;
+        double parsed = std::strtod(copy.c_str(), &end);
+        if (end == copy.c_str() || errno == ERANGE) return false;
+#endif
+        if (parsed != 0 && std::fabs(parsed) < DBL_MIN) return false;
+        value = parsed;
+        return true;
+    }
+
+    // Why ReadRadixLiteral gave up: a part with no digits at all, or digits too many to fit
+    static speccybasic::DiagnosticCode LiteralProblem(std::string_view digits) {
+        size_t dotPos = digits.find('.');
+        bool empty = dotPos == 0 || (dotPos != std::string_view::npos && dotPos + 1 < digits.length() && digits[dotPos + 1] == '.');
+        return empty ? speccybasic::DiagnosticCode::InvalidNumber : speccybasic::DiagnosticCode::NumberOutOfRange;
+    }
+
+    // Records a literal that was stored as 0, at column i + 1 of the line's text
+    static void ReportNumber(speccybasic::Diagnostics* diagnostics, int lineNum, size_t i, std::string_view literal,
+                             speccybasic::DiagnosticCode code) {
+        if (!diagnostics) return;
+        std::string message = code == speccybasic::DiagnosticCode::NumberOutOfRange ? "number out of range, stored as 0: "
+                                                                                     : "invalid number, stored as 0: ";
+        diagnostics->Add(lineNum, static_cast<int>(i + 1), code, message + std::string(literal));
+    }
+
+    template <bool Counting, bool Next>
+    bool BasConverter::ParseLine(int lineNum, std::string_view text, std::vector<uint8_t>& output,
+                                 speccybasic::ConversionStats* stats, speccybasic::Diagnostics* diagnostics) const {
+        // Line header goes in first as a placeholder; its length field is patched once the line ends
+        size_t lineStart = output.size();
+        output.push_back(static_cast<uint8_t>((lineNum >> 8) & 0xFF));
+        output.push_back(static_cast<uint8_t>(lineNum & 0xFF));
+        output.push_back(0x00);
+        output.push_back(0x00);
+        size_t bodyStart = output.size();
+
+        bool expectCommand = true;
+
+        // Exact state machine tracker for duplicating JS tokenization flow
+        ScopeStack in_stack;
+
+        // NextBASIC Integer Expression logic trackers
+        bool inIntExpression = false;
+        bool inIf = false;
+        bool inUntil = false;
+        int intParensDepth = 0;
+
+        // SubStatement Tracker: Explicitly models the JS flag `intSubStatement`
+        // that completely blocks `resetIntExpression()` calls until `:` forces a reset
+        bool intSubStatement = false;
+
+        // Located on the first IF only, so each line is scanned for THEN at most once
+        size_t lastThen = std::string_view::npos;
+        bool thenScanned = false;
+
+        // Inner steps are only timed when profiling; counters are kept whenever stats are. Without
+        // Counting, stats is a compile-time null and every hook below folds away.
+        if constexpr (!Counting) stats = nullptr;
+        bool profile = stats && stats->Profile;
+        uint64_t* keywordTime = profile ? &stats->KeywordNs : nullptr;
+        uint64_t* numberTime = profile ? &stats->NumberNs : nullptr;
+        uint64_t* copyTime = profile ? &stats->CopyNs : nullptr;
+
+        for (size_t i = 0; i < text.length(); i++) {
+
+            if constexpr (Next) {
+                // Literal Resets for inIntExpression
+                if (text[i] == '=' || text[i] == ',' || text[i] == ';' || text[i] == ':') {
+                    if (intParensDepth == 0 && !inIf && !inUntil) {
+                        if (!intSubStatement) inIntExpression = false;
+                    }
+                }
+
+                // `:` forces a total reset, wiping EVERYTHING
+                if (text[i] == ':') {
+                    inIf = false;
+                    inUntil = false;
+                    intParensDepth = 0;
+                    inIntExpression = false;
+                    intSubStatement = false;
+                }
+
+                // NextBASIC integer expression prefix '%'
+                if (text[i] == '%') {
+                    inIntExpression = true;
+
+                    // Track startOfStatement flag logic.
+                    bool startOfIntStatement = false;
+
+                    if (output.size() == bodyStart) {
+                        startOfIntStatement = true;
+                    } else {
+                        for (size_t idx = output.size(); idx-- > bodyStart; ) {
+                            uint8_t b = output[idx];
+                            if (b == ' ' || b == '\t') continue;
+                            // ':', '=', ERROR, IF, ELSE IF, ELSE, UNTIL or DEF FN
+                            if (speccybasic::TokenAttributes[b] & speccybasic::StartsIntStatement) {
+                                startOfIntStatement = true;
+                            }
+                            break;
+                        }
+                    }
+
+                    if (startOfIntStatement) {
+                        intSubStatement = true;
+                    }
+
+                    output.push_back('%');
+                    expectCommand = false;
+                    if (i + 1 < text.length() && text[i+1] == ' ') i++; // JS slurps exactly ONE space after symbols
+                    continue;
+                }
+            } else if (text[i] == '%' && Language == Dialect::Auto) {
+                return false;
+            }
+
+            // 2. DOT COMMAND (.run, etc.)
+            if constexpr (Next) {
+                if (expectCommand && text[i] == '.') {
+                    if (i + 1 < text.length() && std::isdigit(static_cast<unsigned char>(text[i+1]))) {
+                        // It's a float, fall through
+                    } else {
+                        size_t pos = i;
+                        while (pos < text.length()) {
+                            pos += speccybasic::FindAnyOf(reinterpret_cast<const uint8_t*>(text.data()) + pos, text.length() - pos, '"', ':', '\n', '\n');
+                            if (pos >= text.length() || text[pos] != '"') break;
+
+                            size_t endQuote = text.find('"', pos + 1);
+                            if (endQuote != std::string_view::npos) pos = endQuote + 1;
+                            else pos = text.length();
+                        }
+                        speccybasic::ScopedTimer copyTimer(copyTime);
+                        std::string_view dotCmd = text.substr(i, pos - i);
+                        output.insert(output.end(), dotCmd.begin(), dotCmd.end());
+                        i = pos - 1;
+                        expectCommand = false;
+                        if (i + 1 < text.length() && text[i+1] == ' ') i++;
+                        continue;
+                    }
+                }
+            } else if (expectCommand && text[i] == '.' && Language == Dialect::Auto &&
+                       !(i + 1 < text.length() && std::isdigit(static_cast<unsigned char>(text[i+1])))) {
+                return false;
+            }
+
+            // 3. STRINGS
+            if (text[i] == '"') {
+                speccybasic::ScopedTimer copyTimer(copyTime);
+                expectCommand = false;
+                size_t endQuote = text.find('"', i + 1);
+                if (endQuote == std::string_view::npos) {
+                    std::string_view literal = text.substr(i);
+                    output.insert(output.end(), literal.begin(), literal.end());
+                    i = text.length();
+                    in_stack.PopTo(Scope::StringExpression); // REPLICATE JS BUG - destroys whole stack if string expression not found
+                    in_stack.Push(Scope::StringExpression);
+                    break;
+                } else {
+                    std::string_view literal = text.substr(i, endQuote - i + 1);
+                    output.insert(output.end(), literal.begin(), literal.end());
+                    i = endQuote;
+                    in_stack.PopTo(Scope::StringExpression); // REPLICATE JS BUG - destroys whole stack if string expression not found
+                    in_stack.Push(Scope::StringExpression);
+                    if (i + 1 < text.length() && text[i+1] == ' ') i++; // JS eats space after quotes too
+                }
+                continue;
+            }
+
+            // 4. INLINE COMMENTS (;)
+            if (text[i] == ';') {
+                bool isComment = true;
+                // If it is evaluating after spaces, check the last valid command separator byte
+                // Extends to evaluate against THEN and ELSE command contexts safely.
+                for (size_t idx = output.size(); idx-- > bodyStart; ) {
+                    uint8_t b = output[idx];
+                    if (b == ' ' || b == '\t') continue;
+                    if (speccybasic::TokenAttributes[b] & speccybasic::StartsComment) { // ':', ERROR, THEN or ELSE
+                        isComment = true;
+                        break;
+                    }
+                    isComment = false;
+                    break;
+                }
+
+                if (isComment || output.size() == bodyStart) {
+                    speccybasic::ScopedTimer copyTimer(copyTime);
+                    std::string_view comment = text.substr(i);
+                    output.insert(output.end(), comment.begin(), comment.end());
+                    break;
+                }
+            }
+
+            // 5. KEYWORDS
+            bool matched = false;
+            std::string_view k;
+            uint8_t token = 0;
+            bool found;
+            {
+                speccybasic::ScopedTimer keywordTimer(keywordTime);
+                found = speccybasic::Keywords.Match(text, i, k, token);
+            }
+            if (found) {
+                if (stats) stats->Tokens++;
+                if (token == 0xCE) { // Set DEF FN state
+                    in_stack.Push(Scope::DefFn);
+                    in_stack.Push(Scope::DefFnSig);
+                }
+
+                if (token == 0xFA) { // IF
+                    if (!thenScanned) {
+                        lastThen = FindLastThen(text);
+                        thenScanned = true;
+                    }
+                    bool hasThen = lastThen != std::string_view::npos && lastThen > i;
+                    if (!hasThen) token = 0x83; // Block IF
+                }
+
+                uint16_t attributes = speccybasic::TokenAttributes[token];
+                if constexpr (Next) {
+                    // Explicitly mirrors opTable.ELSEIF missing key bug inside manageTokenState allowing block IFs to bypass the IF stack
+                    if (attributes & speccybasic::OpensIf) inIf = true;
+
+                    if (attributes & speccybasic::ClosesIf) {
+                        inIf = false; // THEN and ENDIF
+                        inIntExpression = false; // Evaluates int Expression Reset unconditionally
+                        intSubStatement = false;
+                    }
+                    if (attributes & speccybasic::OpensUntil) inUntil = true;
+
+                    // Operator check for inIntExpression Reset Logic.
+                    // JS: if (inIntExpression && operators.includes(token.text)) { nop } else { resetIntExpression(); }
+                    if (inIntExpression && intParensDepth > 0) {
+                        // nop
+                    } else if (intSubStatement) {
+                        // nop
+                    } else if (!(attributes & (speccybasic::IntOperator | speccybasic::IntFunction))) {
+                        inIntExpression = false;
+                        intSubStatement = false;
+                    }
+                }
+
+                if (attributes & speccybasic::RestOfLine) { // REM
+                    output.push_back(token);
+                    size_t r = i + k.length();
+                    if (r < text.length() && text[r] == ' ') r++; // Skip exactly 1 space
+                    if (r < text.length()) {
+                        speccybasic::ScopedTimer copyTimer(copyTime);
+                        std::string_view remText = text.substr(r);
+                        output.insert(output.end(), remText.begin(), remText.end());
+                    }
+                    i = text.length(); // Break outer loop
+                    matched = true;
+                } else if (token == 0x82) { // PRIVATE
+                    output.push_back(token);
+                    size_t j = i + k.length();
+                    while (j < text.length() && (text[j] == ' ' || text[j] == '\t')) j++;
+                    bool hasClear = false;
+                    if (j + 5 <= text.length() && CaseInsensitiveEquals(text.substr(j, 5), "CLEAR")) {
+                        hasClear = true;
+                    }
+                    if (!hasClear) {
+                        output.push_back(0x0E); // Padding marker
+                        for (int z = 0; z < 5; z++) output.push_back(0x00);
+                    }
+                    i += k.length() - 1;
+                    if (i + 1 < text.length() && text[i+1] == ' ') i++; // JS Space slurp
+                    matched = true;
+                } else if (token == 0xC4) { // BIN
+                    output.push_back(token);
+                    size_t j = i + k.length();
+                    while (j < text.length() && (text[j] == ' ' || text[j] == '\t')) j++;
+                    size_t binStart = j;
+                    while (j < text.length() && (text[j] == '0' || text[j] == '1')) j++;
+                    std::string_view binStr = text.substr(binStart, j - binStart);
+                    if (!binStr.empty()) {
+                        output.insert(output.end(), binStr.begin(), binStr.end());
+                        // Only add pack marker if we're not inside a tight integer expression
+                        if (!(Next && inIntExpression)) {
+                            speccybasic::ScopedTimer numberTimer(numberTime);
+                            if (stats) stats->Numbers++;
+                            output.push_back(0x0E);
+                            unsigned long binVal;
+                            if (ReadUnsigned(binStr, 2, binVal)) {
+                                SinclairNumber::Packed packed = SinclairNumber::Pack(static_cast<double>(binVal));
+                                output.insert(output.end(), packed.begin(), packed.end());
+                            } else {
+                                output.insert(output.end(), 5, 0x00);
+                                ReportNumber(diagnostics, lineNum, binStart, binStr, speccybasic::DiagnosticCode::NumberOutOfRange);
+                            }
+                        }
+                        i = j - 1;
+                    } else {
+                        i += k.length() - 1;
+                    }
+                    expectCommand = false;
+                    if (i + 1 < text.length() && text[i+1] == ' ') i++;
+                    matched = true;
+                } else {
+                    output.push_back(token);
+                    expectCommand = (attributes & speccybasic::CommandFollows) != 0;
+                    i += k.length() - 1;
+                    if (i + 1 < text.length() && text[i+1] == ' ') i++;
+                    matched = true;
+                }
+            }
+
+            if (matched) continue;
+
+            // 6. IDENTIFIERS & VARIABLES
+            if (std::isalpha(static_cast<unsigned char>(text[i]))) {
+                size_t j = i;
+                while (j < text.length() && (std::isalnum(static_cast<unsigned char>(text[j])) || text[j] == '_' || text[j] == '$')) {
+                    j++;
+                }
+                std::string_view ident = text.substr(i, j - i);
+                output.insert(output.end(), ident.begin(), ident.end());
+
+                if (in_stack.IsIn(Scope::StringExpression)) {
+                    in_stack.PopTo(Scope::StringExpression); // REPLICATE JS BUG - wipes DEFFN scope context accidentally alongside string expression
+                }
+                if (!ident.empty() && ident.back() == '$') {
+                    in_stack.Push(Scope::StringExpression);
+                }
+                if (in_stack.IsIn(Scope::DefFnArgs)) {
+                    // String variables do not get numerical space allocation in Sinclair BASIC
+                    if (ident.empty() || ident.back() != '$') {
+                        output.push_back(0x0E); // Padding marker for DEF FN arguments
+                        for (int z = 0; z < 5; z++) output.push_back(0x00);
+                    }
+                }
+
+                // JS processIdentifier does NOT manually hack the tracker out.
+                // It cleanly falls through allowing trailing symbols to determine scope closure natively.
+
+                i = j - 1;
+                expectCommand = false;
+                if (i + 1 < text.length() && text[i+1] == ' ') i++;
+                continue;
+            }
+
+            // 7. HEX NEXTBASIC OPERATORS (e.g. $)
+            if constexpr (Next) {
+                if (text[i] == '$') {
+                    size_t j = i + 1;
+                    while (j < text.length() && (std::isxdigit(static_cast<unsigned char>(text[j])) || text[j] == '.')) j++;
+                    std::string_view hexStr = text.substr(i + 1, j - i - 1);
+                    if (!hexStr.empty()) {
+                        output.insert(output.end(), text.begin() + i, text.begin() + j);
+                        if (!inIntExpression) {
+                            speccybasic::ScopedTimer numberTimer(numberTime);
+                            if (stats) stats->Numbers++;
+                            output.push_back(0x0E);
+                            double val;
+                            if (ReadRadixLiteral(hexStr, 16, val)) {
+                                SinclairNumber::Packed packed = SinclairNumber::Pack(val);
+                                output.insert(output.end(), packed.begin(), packed.end());
+                            } else {
+                                output.insert(output.end(), 5, 0x00);
+                                ReportNumber(diagnostics, lineNum, i, text.substr(i, j - i), LiteralProblem(hexStr));
+                            }
+                        }
+                        i = j - 1;
+                        expectCommand = false;
+                        if (i + 1 < text.length() && text[i+1] == ' ') i++;
+                        continue;
+                    }
+                }
+                if (text[i] == '@') {
+                    size_t j = i + 1;
+                    while (j < text.length() && (text[j] == '0' || text[j] == '1' || text[j] == '.')) j++;
+                    std::string_view binStr = text.substr(i + 1, j - i - 1);
+                    if (!binStr.empty()) {
+                        output.insert(output.end(), text.begin() + i, text.begin() + j);
+                        if (!inIntExpression) {
+                            speccybasic::ScopedTimer numberTimer(numberTime);
+                            if (stats) stats->Numbers++;
+                            output.push_back(0x0E);
+                            double val;
+                            if (ReadRadixLiteral(binStr, 2, val)) {
+                                SinclairNumber::Packed packed = SinclairNumber::Pack(val);
+                                output.insert(output.end(), packed.begin(), packed.end());
+                            } else {
+                                output.insert(output.end(), 5, 0x00);
+                                ReportNumber(diagnostics, lineNum, i, text.substr(i, j - i), LiteralProblem(binStr));
+                            }
+                        }
+                        i = j - 1;
+                        expectCommand = false;
+                        if (i + 1 < text.length() && text[i+1] == ' ') i++;
+                        continue;
+                    }
+                }
+            } else if (Language == Dialect::Auto && StartsNextLiteral(text, i)) {
+                return false;
+            }
+
+            // 8. NUMBERS
+            if (std::isdigit(static_cast<unsigned char>(text[i])) ||
+               (text[i] == '.' && i + 1 < text.length() && std::isdigit(static_cast<unsigned char>(text[i+1])))) {
+
+                expectCommand = false;
+
+                // Numbers inside integer expressions don't get a 6-byte marker. Strictly mirror JS skip marker behavior.
+                bool skipMarker = Next && inIntExpression;
+
+                size_t j = i;
+                while (j < text.length() && (std::isdigit(static_cast<unsigned char>(text[j])) || text[j] == '.' ||
+                        (text[j] == 'E' || text[j] == 'e'))) {
+                    if (text[j] == 'E' || text[j] == 'e') {
+                        j++;
+                        if (j < text.length() && (text[j] == '+' || text[j] == '-')) j++;
+                    } else {
+                        j++;
+                    }
+                }
+                std::string_view numStr = text.substr(i, j - i);
+
+                if (!skipMarker) {
+                    speccybasic::ScopedTimer numberTimer(numberTime);
+                    if (stats) stats->Numbers++;
+                    double val = 0;
+                    if (!ReadDecimal(numStr, val)) {
+                        ReportNumber(diagnostics, lineNum, i, numStr, speccybasic::DiagnosticCode::NumberOutOfRange);
+                    }
+                    output.insert(output.end(), numStr.begin(), numStr.end());
+                    output.push_back(0x0E); // Explicitly required 6-byte payload start on normal floating ints
+                    SinclairNumber::Packed packed = SinclairNumber::Pack(val);
+                    output.insert(output.end(), packed.begin(), packed.end());
+                } else {
+                    output.insert(output.end(), numStr.begin(), numStr.end());
+                }
+
+                i = j - 1;
+                if (i + 1 < text.length() && text[i+1] == ' ') i++;
+                continue;
+            }
+
+            // 9. EXTRA SPACES
+            if (text[i] == ' ' || text[i] == '\t') {
+                output.push_back(static_cast<uint8_t>(text[i]));
+                continue;
+            }
+
+            // 10. LITERAL
+            uint8_t c = static_cast<uint8_t>(text[i]);
+            output.push_back(c);
+
+            if constexpr (Next) {
+                // Replicate JS Literal Expression Wiping Bug natively
+                if (c == '=') {
+                    if (!inIf && !inUntil) {
+                        inIntExpression = false;
+                        intSubStatement = false;
+                    }
+                } else if (c == ',' || c == ';') {
+                    if (intParensDepth == 0 && !inIf && !inUntil) {
+                        inIntExpression = false;
+                        intSubStatement = false;
+                    }
+                }
+                if (c == ':') {
+                    inIf = false;
+                    inUntil = false;
+                    intParensDepth = 0;
+                    inIntExpression = false;
+                    intSubStatement = false;
+                }
+            }
+
+            if (c == ':') {
+                expectCommand = true;
+                in_stack.Clear();
+            } else {
+                expectCommand = false;
+            }
+
+            if (c == '(') {
+                if (Next && inIntExpression) intParensDepth++;
+                in_stack.Push(Scope::OpenParens);
+                if (in_stack.IsIn(Scope::DefFnSig)) {
+                    in_stack.Push(Scope::DefFnArgs);
+                }
+            } else if (c == ')') {
+                if (Next && intParensDepth > 0) intParensDepth--;
+                in_stack.PopTo(Scope::OpenParens);
+            } else if (c == '=') {
+                if (in_stack.IsTop(Scope::DefFnSig)) {
+                    in_stack.PopTo(Scope::DefFnSig);
+                }
+            }
+
+            if (i + 1 < text.length() && text[i+1] == ' ') i++;
+        }
+
+        output.push_back(0x0D);
+
+        size_t length = output.size() - bodyStart;
+        output[lineStart + 2] = static_cast<uint8_t>(length & 0xFF);
+        output[lineStart + 3] = static_cast<uint8_t>((length >> 8) & 0xFF);
+        return true;
+    }
+}
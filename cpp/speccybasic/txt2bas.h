@@ -0,0 +1,123 @@
+#ifndef TXT2BAS_H
+#define TXT2BAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "diagnostics.h"
+#include "linecache.h"
+#include "number.h"
+#include "optimize.h"
+#include "stats.h"
+
+namespace txt2bas {
+
+    class Plus3Dos {
+    public:
+        static constexpr size_t HeaderSize = 128;
+
+        static std::vector<uint8_t> CreateHeader(int basicLength, int autoStartLine);
+        // Fills HeaderSize bytes in place, e.g. the slot reserved at the front of ConvertFile's output
+        static void WriteHeader(uint8_t* header, int basicLength, int autoStartLine);
+    };
+
+    // ZX Spectrum tape images. A 17-byte header block names the program, then the program follows
+    // as a data block; each block starts with a flag byte and ends with an XOR checksum. TZX carries
+    // the same two blocks as standard-speed (ID 0x10) blocks behind its own signature.
+    class Tape {
+    public:
+        static constexpr size_t NameLength = 10;
+        static constexpr size_t HeaderBlockSize = 19; // Flag, 17 header bytes, checksum
+        // Bytes ahead of the program: TAP's header block and the data block's length and flag, or for
+        // TZX its signature and both blocks' ID, pause and length fields as well
+        static constexpr size_t TapPrefixSize = 2 + HeaderBlockSize + 3;
+        static constexpr size_t TzxPrefixSize = 10 + 5 + HeaderBlockSize + 6;
+        static constexpr size_t SuffixSize = 1; // The data block's checksum
+
+        // Fill the prefix in place and the checksum byte behind the program's basicLength bytes
+        static void WriteTap(uint8_t* file, size_t basicLength, int autoStartLine);
+        static void WriteTzx(uint8_t* file, size_t basicLength, int autoStartLine);
+
+        // Sets the name in a header block (padded or cut to NameLength) and updates its checksum
+        static void SetName(uint8_t* headerBlock, std::string_view name);
+    };
+
+    using speccybasic::SinclairNumber;
+
+    // What Convert wraps the tokenized program in. Raw is the bare program, e.g. for embedding in a ROM.
+    enum class Container { Plus3Dos, Tap, Tzx, Raw };
+
+    // Which BASIC the listing is written in. Sinclair48K drops the NextBASIC-only syntax: % integer
+    // expressions, dot commands and $hex/@binary literals are read as plain characters (keywords are
+    // the same in every dialect). Auto tokenizes each line on that leaner path and moves to the full
+    // NextBASIC tokenizer at the first line that needs it, so the output never differs from NextBasic.
+    enum class Dialect { Auto, NextBasic, Sinclair48K };
+
+    size_t ContainerPrefixSize(Container container);
+    size_t ContainerSuffixSize(Container container);
+
+    // Everything one conversion produces; the converter itself keeps no per-file state
+    struct ConversionResult {
+        std::vector<uint8_t> FileData; // The container's header, the tokenized program, then any trailer
+        int AutoStartLine = 32768;
+        Container Format = Container::Plus3Dos;
+        Dialect Language = Dialect::Auto;
+        OptimizeSavings Saved; // What BasConverter::Optimize took out of the program
+
+        size_t BasicLength() const { return FileData.size() - ContainerPrefixSize(Format) - ContainerSuffixSize(Format); }
+
+        // Names the program in a TAP or TZX header (blank until set); the other containers have no name
+        void SetName(std::string_view name);
+    };
+
+    // One line of a listing: its number, as written or ten on from the line before, and the text after
+    // it, a view into the listing
+    struct SourceLine {
+        int LineNum;
+        std::string_view Text;
+    };
+
+    // Splits a listing into numbered lines as Convert reads it, in place of what numbered held. Blank
+    // lines and # directives are left out; an #autostart sets autoStartLine when given one.
+    void SplitListing(std::string_view source, std::vector<SourceLine>& numbered, int* autoStartLine = nullptr);
+
+    // Holds only configuration, so one instance can be shared by any number of files and threads
+    class BasConverter {
+    private:
+        static constexpr size_t MinLinesPerChunk = 512;
+
+        // Appends one tokenized line (4-byte header, tokens, 0x0D) to output; Counting fills in stats.
+        // Without Next the NextBASIC-only branches are compiled out, and in Auto mode it returns false,
+        // leaving a partial line behind, as soon as the line turns out to need one of them. Numbers that
+        // can't be packed are stored as 0 as ever, and recorded in diagnostics when given one.
+        template <bool Counting, bool Next>
+        bool ParseLine(int lineNum, std::string_view text, std::vector<uint8_t>& output, speccybasic::ConversionStats* stats,
+                       speccybasic::Diagnostics* diagnostics) const;
+
+    public:
+        // Threads used to tokenize a single large file: 0 picks one per core, 1 forces the serial path.
+        // Output is byte-identical either way.
+        unsigned LineThreads = 0;
+        // Listings with fewer lines than this are always tokenized serially
+        size_t ParallelLineThreshold = 4096;
+        // The container is written around the program as it is produced, never as a second pass
+        Container Format = Container::Plus3Dos;
+        Dialect Language = Dialect::Auto;
+        // Rewrites applied to the whole program once it is tokenized, off by default. The line cache
+        // keeps the bytes from before them. %n is only written for Dialect::NextBasic.
+        OptimizeOptions Optimize;
+
+        // Fills in stats (split and tokenize times, counters) when given one. With a cache, lines it already
+        // holds are copied rather than tokenized, the rest are tokenized serially and stored, and lines
+        // no longer in the source are pruned from it. Diagnostics collects what was worked around, in line
+        // order; lines copied from the cache aren't looked at again, so it only covers the rest.
+        ConversionResult Convert(std::string_view source, speccybasic::ConversionStats* stats = nullptr,
+                                 LineCache* cache = nullptr, speccybasic::Diagnostics* diagnostics = nullptr) const;
+    };
+
+} // namespace txt2bas
+
+#endif // TXT2BAS_H
\ No newline at end of file
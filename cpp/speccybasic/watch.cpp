@@ -0,0 +1,123 @@
+#include "watch.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace speccybasic {
+
+    namespace fs = std::filesystem;
+
+    // How long the directory must stay quiet before a change is reported
+    [[maybe_unused]] static constexpr int SettleMs = 50;
+
+    static bool ExtensionMatches(const fs::path& path, const std::string& extension) {
+        std::string actual = path.extension().string();
+        return actual.size() == extension.size() &&
+               std::equal(actual.begin(), actual.end(), extension.begin(), [](char a, char b) {
+                   return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+               });
+    }
+
+    std::map<std::string, FileStamp> ScanDirectory(const std::string& dir, const std::string& extension) {
+        std::map<std::string, FileStamp> files;
+        std::error_code error;
+        for (const auto& entry : fs::directory_iterator(dir, error)) {
+            if (!entry.is_regular_file(error) || !ExtensionMatches(entry.path(), extension)) continue;
+
+            // A file deleted between listing and stat is simply left out
+            FileStamp stamp;
+            stamp.WriteTime = entry.last_write_time(error);
+            if (error) continue;
+            stamp.Size = entry.file_size(error);
+            if (error) continue;
+            files[entry.path().string()] = stamp;
+        }
+        if (error) throw std::runtime_error("Could not list directory: " + dir);
+        return files;
+    }
+
+#ifdef _WIN32
+
+    DirectoryWatcher::DirectoryWatcher(const std::string& dir) {
+        HANDLE handle = FindFirstChangeNotificationA(dir.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+        if (handle == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not watch directory: " + dir);
+        _handle = handle;
+    }
+
+    DirectoryWatcher::~DirectoryWatcher() {
+        FindCloseChangeNotification(static_cast<HANDLE>(_handle));
+    }
+
+    void DirectoryWatcher::Wait() {
+        HANDLE handle = static_cast<HANDLE>(_handle);
+        WaitForSingleObject(handle, INFINITE);
+        do {
+            FindNextChangeNotification(handle);
+        } while (WaitForSingleObject(handle, SettleMs) == WAIT_OBJECT_0);
+    }
+
+#elif defined(__linux__)
+
+    DirectoryWatcher::DirectoryWatcher(const std::string& dir) {
+        _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_fd < 0) throw std::runtime_error("Could not start inotify.");
+        uint32_t mask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+        if (inotify_add_watch(_fd, dir.c_str(), mask) < 0) {
+            close(_fd);
+            throw std::runtime_error("Could not watch directory: " + dir);
+        }
+    }
+
+    DirectoryWatcher::~DirectoryWatcher() {
+        close(_fd);
+    }
+
+    void DirectoryWatcher::Wait() {
+        // The events themselves are not needed, only that some arrived
+        alignas(inotify_event) char buffer[4096];
+        pollfd watched = { _fd, POLLIN, 0 };
+        int timeout = -1;
+        for (;;) {
+            int ready = poll(&watched, 1, timeout);
+            if (ready == 0) return;
+            // Returning would only have the caller rescan and come straight back, so anything but a
+            // signal ends the watch
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0) throw std::system_error(errno, std::generic_category(), "Could not wait for changes");
+            if (watched.revents & (POLLERR | POLLHUP | POLLNVAL)) throw std::runtime_error("Lost the directory watch.");
+            while (read(_fd, buffer, sizeof(buffer)) > 0) {}
+            timeout = SettleMs;
+        }
+    }
+
+#else
+
+    // No native backend (e.g. macOS, where FSEvents needs a run loop): poll, and let the rescan decide
+    static constexpr int PollMs = 500;
+
+    DirectoryWatcher::DirectoryWatcher(const std::string& dir) {
+        if (!fs::is_directory(dir)) throw std::runtime_error("Not a directory: " + dir);
+    }
+
+    DirectoryWatcher::~DirectoryWatcher() {}
+
+    void DirectoryWatcher::Wait() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(PollMs));
+    }
+
+#endif
+
+} // namespace speccybasic
@@ -0,0 +1,49 @@
+#ifndef SPECCYBASIC_WATCH_H
+#define SPECCYBASIC_WATCH_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+
+// --watch support for the CLIs: wakes up when a directory changes, and finds which files did
+namespace speccybasic {
+
+    struct FileStamp {
+        std::filesystem::file_time_type WriteTime;
+        uintmax_t Size = 0;
+
+        bool operator==(const FileStamp& other) const { return WriteTime == other.WriteTime && Size == other.Size; }
+        bool operator!=(const FileStamp& other) const { return !(*this == other); }
+    };
+
+    // Regular files directly in dir whose extension matches (ignoring case), with their stamps
+    std::map<std::string, FileStamp> ScanDirectory(const std::string& dir, const std::string& extension);
+
+    // Uses inotify on Linux and change notifications on Windows; elsewhere it polls. Events only say
+    // that something changed, the caller rescans to find out what, so a missed or merged event costs
+    // nothing but a little latency.
+    class DirectoryWatcher {
+    private:
+#ifdef _WIN32
+        void* _handle = nullptr;
+#else
+        int _fd = -1;
+#endif
+
+    public:
+        explicit DirectoryWatcher(const std::string& dir);
+        ~DirectoryWatcher();
+
+        // Blocks until the directory may have changed, then waits for writes to settle so an editor's
+        // save (often a truncate, several writes and a rename) is seen as one change. Throws if the
+        // directory can no longer be watched.
+        void Wait();
+
+        DirectoryWatcher(const DirectoryWatcher&) = delete;
+        DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+    };
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_WATCH_H
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef SPECCYBASIC_WORKPOOL_H
+#define SPECCYBASIC_WORKPOOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace speccybasic {
+
+    // Number of workers to use for a -j request; 0 means one per hardware thread
+    inline unsigned ResolveThreadCount(unsigned requested, size_t taskCount) {
+        unsigned threads = requested;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        if (taskCount < threads) threads = static_cast<unsigned>(std::max<size_t>(1, taskCount));
+        return threads;
+    }
+
+    // Runs task(index, worker) for every index in [0, taskCount) across `threads` workers.
+    // Each worker starts with a contiguous slice of the indices and takes from the front of its own
+    // queue; once that runs dry it steals from the back of the others, so a few huge files cannot
+    // leave the rest of the pool idle. Tasks must not throw - report failures through their results.
+    template <typename Task>
+    void RunWorkStealing(size_t taskCount, unsigned threads, Task task) {
+        threads = ResolveThreadCount(threads, taskCount);
+        if (threads <= 1) {
+            for (size_t i = 0; i < taskCount; i++) task(i, 0u);
+            return;
+        }
+
+        struct WorkQueue {
+            std::mutex Lock;
+            std::deque<size_t> Items;
+        };
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        for (unsigned w = 0; w < threads; w++) queues.push_back(std::make_unique<WorkQueue>());
+        for (size_t i = 0; i < taskCount; i++) {
+            queues[i * threads / taskCount]->Items.push_back(i);
+        }
+
+        auto next = [&](unsigned worker, size_t& index) {
+            {
+                WorkQueue& own = *queues[worker];
+                std::lock_guard<std::mutex> guard(own.Lock);
+                if (!own.Items.empty()) {
+                    index = own.Items.front();
+                    own.Items.pop_front();
+                    return true;
+                }
+            }
+            for (unsigned offset = 1; offset < threads; offset++) {
+                WorkQueue& victim = *queues[(worker + offset) % threads];
+                std::lock_guard<std::mutex> guard(victim.Lock);
+                if (!victim.Items.empty()) {
+                    index = victim.Items.back();
+                    victim.Items.pop_back();
+                    return true;
+                }
+            }
+            return false; // Nothing is ever added once started, so every queue being empty means done
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < threads; w++) {
+            workers.emplace_back([&, w]() {
+                size_t index;
+                while (next(w, index)) task(index, w);
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+    }
+
+} // namespace speccybasic
+
+#endif // SPECCYBASIC_WORKPOOL_H
\ No newline at end of file
@@ -0,0 +1,567 @@
+#include "speccybasic/archive.h"
+#include "speccybasic/batch.h"
+#include "speccybasic/mappedfile.h"
+#include "speccybasic/profile.h"
+#include "speccybasic/speccybasic.h"
+#include "speccybasic/txt2bas.h"
+#include "speccybasic/watch.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#ifndef TOOL_VERSION
+#define TOOL_VERSION "1.0"
+#endif
+
+void PrintHelp() {
+    std::cout << "  _______     _   ___  ___          \n"
+              << " |__   __|   | | |__ \\|  _ \\         \n"
+              << "    | |___  _| |_   ) | |_) | __ _ ___\n"
+              << "    | / \\ \\/ / __| / /|  _ < / _` / __|\n"
+              << "    | |  >  <| |_ / /_| |_) | (_| \\__ \\\n"
+              << "    |_| /_/\\_\\\\__|____|____/ \\__,_|___/\n\n"
+              << "ZX Spectrum Text-to-BASIC Converter v" << TOOL_VERSION << "\n\n"
+              << "Usage: txt2bas [options] <input.txt> <output.bas>\n"
+              << "       txt2bas --batch <in.txt> <out.bas> [<in.txt> <out.bas> ...]\n"
+              << "       txt2bas --dir <input-dir> <output-dir>\n"
+              << "       txt2bas --manifest <file>\n"
+              << "       txt2bas --watch <input-dir> [<output-dir>]\n"
+              << "       txt2bas --archive <in.zip|in.tar> <out.zip|out.tar>\n"
+              << "       txt2bas --analyze[=FILE] <input.txt|archive>... [-j N]\n"
+              << "       txt2bas -j <N> <batch options>\n\n"
+              << "Options:\n"
+              << "  -h, --help     Show this help message and exit\n"
+              << "  -v, --version  Show version information and exit\n"
+              << "  -j <N>         Convert N files at a time in batch mode (0 = all cores)\n"
+              << "  --serial       Tokenize large files on one thread (for debugging)\n"
+              << "  --format <F>   Output container: plus3dos (default), tap, tzx or raw\n"
+              << "                 (the program alone, no header)\n"
+              << "  --dialect <D>  auto (default), next or 48k; 48k reads %, dot commands and\n"
+              << "                 $/@ literals as plain characters, auto uses the faster\n"
+              << "                 48K tokenizer on every program that doesn't need NextBASIC\n"
+              << "  --verify       Decode each program again in memory and fail if it doesn't\n"
+              << "                 match the source (case, spacing and keyword aliases aside)\n"
+              << "  --optimize[=LIST]\n"
+              << "                 Make the program smaller: any of spaces, rems, numbers and\n"
+              << "                 val, or all (default spaces,numbers); see below\n"
+              << "  --cache[=FILE] Keep each line's tokens in FILE (default <output>.cache)\n"
+              << "                 and only tokenize lines changed since the last run\n"
+              << "  --stats[=FILE] Report phase times and counters as JSON (to FILE, or in\n"
+              << "                 place of the status line)\n"
+              << "  --profile[=FILE]\n"
+              << "                 As --stats, also timing keyword matching, number packing\n"
+              << "                 and string/REM copying (slows tokenizing down)\n\n"
+              << "Use - as the input or output to read stdin or write stdout, e.g.\n"
+              << "  cat game.txt | txt2bas - - > game.bas\n\n"
+              << "Batch options may be combined; every file is converted in one run and a\n"
+              << "per-file report is printed at the end. A manifest lists one\n"
+              << "<input> <output> pair per line.\n\n"
+              << "--watch converts every .txt file in the directory, then keeps running and\n"
+              << "re-converts each one as it is saved, re-tokenizing only the changed lines.\n"
+              << "Output goes to <output-dir> (default the input directory). Stop with Ctrl+C.\n\n"
+              << "--archive converts every .txt member of a ZIP, TAR or .tar.gz into a new ZIP\n"
+              << "or TAR (picked by its extension), keeping the folder layout, without\n"
+              << "unpacking anything to disk. Add -j N to convert N members at a time.\n\n"
+              << "--analyze tokenizes each listing (or every .txt member of an archive) and\n"
+              << "reports as JSON where its bytes go: tokens, strings, REMs, hidden number\n"
+              << "payloads and line overhead per line, how often each token is used, and\n"
+              << "what rewriting literals as VAL \"n\", %n or NOT PI/SGN PI would save.\n"
+              << "Nothing is written; the report goes to stdout or FILE.\n\n"
+              << "--optimize rewrites the tokenized program to take fewer bytes, keeping\n"
+              << "what it does: spaces drops spaces outside strings, REMs and dot commands,\n"
+              << "rems empties REMs and ; comments, dropping \": REM ...\" altogether, numbers\n"
+              << "writes 1 as SGN PI, 0 as NOT PI and, with --dialect next, whole numbers as\n"
+              << "%n where that is safe, and val writes other literals as VAL \"n\" (smaller\n"
+              << "but slower). No line is removed or renumbered; the bytes saved are shown.\n";
+}
+
+static std::string ReadFile(const std::string& path) {
+    // Open safely as a binary array to avoid missing line breaks and carriage returns (\r)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) throw std::runtime_error("Could not open file: " + path);
+
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    std::string text(size, '\0');
+    if (size > 0) {
+        if (!file.read(&text[0], size)) {
+            throw std::runtime_error("Failed to read file.");
+        }
+    }
+    file.close();
+
+    return text;
+}
+
+// The whole listing is needed before tokenizing starts (the line delimiter depends on whether any \r
+// appears), so stdin is read to the end rather than streamed
+static std::string ReadStdin() {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    std::string text;
+    char chunk[65536];
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0) {
+        text.append(chunk, got);
+    }
+    if (std::ferror(stdin)) throw std::runtime_error("Failed to read stdin.");
+
+    return text;
+}
+
+// The +3DOS header is filled in once the program is complete, so the image goes out in a single write
+static void WriteStdout(const std::vector<uint8_t>& data) {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    if (std::fwrite(data.data(), 1, data.size(), stdout) != data.size() || std::fflush(stdout) != 0) {
+        throw std::runtime_error("Could not write to stdout.");
+    }
+}
+
+// The sidecar sits next to the output, or the input when writing to stdout
+static std::string CachePath(const std::string& input, const std::string& output) {
+    if (output != "-") return output + ".cache";
+    if (input != "-") return input + ".cache";
+    throw std::runtime_error("--cache needs a file name when reading stdin and writing stdout.");
+}
+
+// A missing, stale or damaged sidecar just means every line is tokenized again
+static void LoadCache(const std::string& path, txt2bas::LineCache& cache) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    cache.Deserialize(data.data(), data.size());
+}
+
+static void SaveCache(const std::string& path, const txt2bas::LineCache& cache) {
+    std::vector<uint8_t> data = cache.Serialize();
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) throw std::runtime_error("Could not open cache file: " + path);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+static txt2bas::Container ParseContainer(const std::string& name) {
+    if (name == "plus3dos" || name == "+3dos") return txt2bas::Container::Plus3Dos;
+    if (name == "tap") return txt2bas::Container::Tap;
+    if (name == "tzx") return txt2bas::Container::Tzx;
+    if (name == "raw") return txt2bas::Container::Raw;
+    throw std::runtime_error("Unknown format " + name + " (expected plus3dos, tap, tzx or raw)");
+}
+
+static txt2bas::Dialect ParseDialect(const std::string& name) {
+    if (name == "auto") return txt2bas::Dialect::Auto;
+    if (name == "next" || name == "nextbasic") return txt2bas::Dialect::NextBasic;
+    if (name == "48k" || name == "48K") return txt2bas::Dialect::Sinclair48K;
+    throw std::runtime_error("Unknown dialect " + name + " (expected auto, next or 48k)");
+}
+
+// --optimize=spaces,rems,numbers,val or all; plain --optimize means spaces,numbers
+static txt2bas::OptimizeOptions ParseOptimize(const std::string& list) {
+    txt2bas::OptimizeOptions options;
+    if (list.empty()) {
+        options.Spaces = options.Numbers = true;
+        return options;
+    }
+    std::istringstream parts(list);
+    std::string name;
+    while (std::getline(parts, name, ',')) {
+        if (name == "spaces") options.Spaces = true;
+        else if (name == "rems") options.Rems = true;
+        else if (name == "numbers") options.Numbers = true;
+        else if (name == "val") options.ValStrings = true;
+        else if (name == "all") options.Spaces = options.Rems = options.Numbers = options.ValStrings = true;
+        else throw std::runtime_error("Unknown optimization " + name + " (expected spaces, rems, numbers, val or all)");
+    }
+    return options;
+}
+
+static std::string ContainerExtension(txt2bas::Container container) {
+    switch (container) {
+        case txt2bas::Container::Tap: return ".tap";
+        case txt2bas::Container::Tzx: return ".tzx";
+        case txt2bas::Container::Raw: return ".bin";
+        default: return ".bas";
+    }
+}
+
+// Tape images carry a 10-character name; take the source's file name, or the output's for stdin
+static std::string TapeName(const std::string& input, const std::string& output) {
+    const std::string& path = (input != "-") ? input : output;
+    return (path == "-") ? std::string() : std::filesystem::path(path).stem().string();
+}
+
+// --verify: decodes the program just made and throws at the first line that doesn't match the source
+static void VerifyProgram(std::string_view text, const txt2bas::ConversionResult& result, speccybasic::ConversionStats* stats) {
+    speccybasic::ScopedTimer verifyTimer(stats ? &stats->VerifyNs : nullptr);
+    speccybasic::VerifyResult check = speccybasic::Verify(text, result.FileData.data(), result.FileData.size());
+    if (check.Matches) return;
+    throw std::runtime_error("Verify failed at line " + std::to_string(check.LineNumber) + ": source \"" + check.Source +
+                             "\", decoded \"" + check.Decoded + "\"");
+}
+
+// "N bytes", then what --optimize saved and whether --verify passed, for the status line and reports
+static std::string SizeSummary(const txt2bas::ConversionResult& result, bool verify) {
+    std::string text = std::to_string(result.BasicLength()) + " bytes";
+    if (result.Saved.Total() > 0) text += ", " + std::to_string(result.Saved.Total()) + " saved";
+    return verify ? text + ", verified" : text;
+}
+
+// Prints what a conversion worked around, for the single-file and watch modes; batches list it in their report
+static void PrintWarnings(const std::string& input, const speccybasic::Diagnostics& warnings, std::ostream& out) {
+    for (const speccybasic::Diagnostic& diagnostic : warnings.Items) {
+        out << "Warning: " << input << ": " << speccybasic::FormatDiagnostic(diagnostic) << "\n";
+    }
+}
+
+// Converts one file and returns its SizeSummary; "-" names stdin/stdout.
+// A non-empty cachePath names the line cache sidecar to reuse and update. With verify, a program that
+// doesn't decode back to its source is not written.
+static std::string ConvertOne(const txt2bas::BasConverter& converter, const std::string& input, const std::string& output,
+                         speccybasic::ConversionStats* stats = nullptr, const std::string& cachePath = std::string(),
+                         bool verify = false, speccybasic::Diagnostics* warnings = nullptr) {
+    speccybasic::ScopedTimer readTimer(stats ? &stats->ReadNs : nullptr);
+    // Files are tokenized straight from the mapping; only stdin needs a copy
+    speccybasic::MappedFile mapped;
+    std::string piped;
+    std::string_view text;
+    if (input == "-") {
+        piped = ReadStdin();
+        text = piped;
+    } else {
+        if (!mapped.Open(input)) throw std::runtime_error("Could not open file: " + input);
+        text = mapped.Text();
+    }
+    txt2bas::LineCache cache;
+    if (!cachePath.empty()) LoadCache(cachePath, cache);
+    readTimer.Stop();
+
+    txt2bas::ConversionResult result = converter.Convert(text, stats, cachePath.empty() ? nullptr : &cache, warnings);
+    result.SetName(TapeName(input, output));
+    if (verify) VerifyProgram(text, result, stats);
+
+    speccybasic::ScopedTimer writeTimer(stats ? &stats->WriteNs : nullptr);
+    if (output == "-") {
+        WriteStdout(result.FileData);
+    } else {
+        std::ofstream out(output, std::ios::binary);
+        if (!out.is_open()) throw std::runtime_error("Could not open output file.");
+
+        out.write(reinterpret_cast<const char*>(result.FileData.data()), result.FileData.size());
+        out.close();
+    }
+
+    if (!cachePath.empty()) SaveCache(cachePath, cache);
+    return SizeSummary(result, verify);
+}
+
+// Runs until interrupted. Each file keeps its line cache in memory between saves, so a one-line edit
+// tokenizes one line.
+static int RunWatch(const txt2bas::BasConverter& converter, const std::string& inputDir, const std::string& outputDir, bool verify) {
+    namespace fs = std::filesystem;
+
+    struct WatchedFile {
+        speccybasic::FileStamp Stamp;
+        txt2bas::LineCache Cache;
+    };
+
+    std::map<std::string, WatchedFile> files;
+    try {
+        if (!fs::is_directory(inputDir)) throw std::runtime_error("Not a directory: " + inputDir);
+        fs::create_directories(outputDir);
+        speccybasic::DirectoryWatcher watcher(inputDir);
+        std::cout << "Watching " << inputDir << " for .txt changes (Ctrl+C to stop)" << std::endl;
+
+        while (true) {
+            std::map<std::string, speccybasic::FileStamp> current = speccybasic::ScanDirectory(inputDir, ".txt");
+
+            // Deleted sources just drop their cache; their output is left alone
+            for (auto it = files.begin(); it != files.end(); ) {
+                it = current.count(it->first) ? std::next(it) : files.erase(it);
+            }
+
+            for (const auto& item : current) {
+                auto known = files.find(item.first);
+                if (known != files.end() && known->second.Stamp == item.second) continue;
+
+                WatchedFile& file = files[item.first];
+                file.Stamp = item.second;
+                fs::path output = fs::path(outputDir) / fs::path(item.first).stem();
+                output += ContainerExtension(converter.Format);
+
+                try {
+                    // Copied rather than mapped: an editor truncating the file mid-read would fault a mapping
+                    std::string text = ReadFile(item.first);
+                    speccybasic::ConversionStats stats;
+                    speccybasic::Diagnostics warnings;
+                    txt2bas::ConversionResult result = converter.Convert(text, &stats, &file.Cache, &warnings);
+                    result.SetName(TapeName(item.first, output.string()));
+                    if (verify) VerifyProgram(text, result, nullptr);
+
+                    std::ofstream out(output, std::ios::binary);
+                    if (!out.is_open()) throw std::runtime_error("Could not open output file.");
+                    out.write(reinterpret_cast<const char*>(result.FileData.data()), result.FileData.size());
+                    out.close();
+
+                    std::cout << "OK     " << item.first << " -> " << output.string() << " (" << SizeSummary(result, verify)
+                              << ", " << stats.CacheMisses << " of " << stats.Lines << " lines tokenized)\n";
+                    PrintWarnings(item.first, warnings, std::cout);
+                    std::cout.flush();
+                } catch (const std::exception& ex) {
+                    // Most likely a half-finished save; the next change tries again
+                    std::cout << "FAILED " << item.first << ": " << ex.what() << std::endl;
+                }
+            }
+
+            watcher.Wait();
+        }
+    } catch (const std::exception& ex) {
+        std::cout << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    txt2bas::BasConverter converter;
+    speccybasic::StatsOptions statsOptions;
+    speccybasic::StatsOptions analyzeOptions;
+    bool useCache = false;
+    bool verify = false;
+    std::string cacheFile;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") { PrintHelp(); return 0; }
+        if (arg == "-v" || arg == "--version") { std::cout << "txt2bas version " << TOOL_VERSION << "\n"; return 0; }
+        if (arg == "--serial") { converter.LineThreads = 1; continue; }
+        if (arg == "--verify") { verify = true; continue; }
+        if (arg == "--format" || arg.rfind("--format=", 0) == 0) {
+            try {
+                if (arg.size() > 8) converter.Format = ParseContainer(arg.substr(9));
+                else if (i + 1 < argc) converter.Format = ParseContainer(argv[++i]);
+                else throw std::runtime_error("--format needs one of plus3dos, tap, tzx or raw");
+            } catch (const std::exception& ex) {
+                std::cout << "Error: " << ex.what() << "\n";
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--dialect" || arg.rfind("--dialect=", 0) == 0) {
+            try {
+                if (arg.size() > 9) converter.Language = ParseDialect(arg.substr(10));
+                else if (i + 1 < argc) converter.Language = ParseDialect(argv[++i]);
+                else throw std::runtime_error("--dialect needs one of auto, next or 48k");
+            } catch (const std::exception& ex) {
+                std::cout << "Error: " << ex.what() << "\n";
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--optimize" || arg.rfind("--optimize=", 0) == 0) {
+            try {
+                converter.Optimize = ParseOptimize(arg.size() > 10 ? arg.substr(11) : std::string());
+            } catch (const std::exception& ex) {
+                std::cout << "Error: " << ex.what() << "\n";
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--cache" || arg.rfind("--cache=", 0) == 0) {
+            useCache = true;
+            if (arg.size() > 7) cacheFile = arg.substr(8);
+            continue;
+        }
+        if (speccybasic::ParseStatsArgument(arg, statsOptions)) continue;
+        if (speccybasic::ParseAnalyzeArgument(arg, analyzeOptions)) continue;
+        args.push_back(arg);
+    }
+
+    // Rewritten REMs and literals no longer decode to the source, while dropped spaces still do
+    if (verify && (converter.Optimize.Rems || converter.Optimize.Numbers || converter.Optimize.ValStrings)) {
+        std::cout << "Error: --verify checks the program against its source, so only --optimize=spaces goes with it\n";
+        return 1;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    uint64_t allocationsBefore = speccybasic::AllocationCount();
+    auto elapsedNs = [&]() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+    };
+
+    if (analyzeOptions.Enabled) {
+        try {
+            if (useCache || statsOptions.Enabled) throw std::runtime_error("--analyze cannot be combined with --cache or --stats");
+            unsigned threads = 1;
+            speccybasic::InputSet inputs(speccybasic::ParseInputArguments(args, threads),
+                                         [](const std::string& name) { return speccybasic::MemberExtension(name) == ".txt"; });
+            if (inputs.Jobs().empty()) throw std::runtime_error("--analyze expects one or more listings or archives");
+            if (threads != 1) converter.LineThreads = 1;
+
+            std::vector<speccybasic::AnalysisEntry> entries(inputs.Jobs().size());
+            auto results = speccybasic::RunBatch(inputs.Jobs(), threads, [&](const speccybasic::BatchJob& job,
+                                                                               speccybasic::Diagnostics& warnings) {
+                size_t index = &job - inputs.Jobs().data();
+                inputs.Read(index, [&](const uint8_t* data, size_t size) {
+                    std::string_view text(reinterpret_cast<const char*>(data), size);
+                    std::vector<uint8_t> program = converter.Convert(text, nullptr, nullptr, &warnings).FileData;
+                    entries[index].Analysis = speccybasic::AnalyzeProgram(program.data(), program.size(), &warnings);
+                });
+                return std::string("analyzed");
+            });
+
+            size_t failed = 0;
+            for (size_t n = 0; n < results.size(); n++) {
+                entries[n].Input = results[n].Job.Input;
+                entries[n].Success = results[n].Success;
+                entries[n].Warnings = results[n].Warnings;
+                if (!results[n].Success) {
+                    entries[n].Error = results[n].Message;
+                    failed++;
+                }
+            }
+            speccybasic::WriteStatsReport(analyzeOptions, speccybasic::FormatAnalysisJson("txt2bas", TOOL_VERSION, entries), std::cout);
+            return failed == 0 ? 0 : 1;
+        } catch (const std::exception& ex) {
+            std::cout << "Error: " << ex.what() << "\n";
+            return 1;
+        }
+    }
+
+    speccybasic::ArchiveOptions archiveOptions;
+    try {
+        if (speccybasic::ParseArchiveArguments(args, archiveOptions)) {
+            if (useCache || statsOptions.Enabled) throw std::runtime_error("--cache and --stats are for files, not --archive");
+            if (archiveOptions.Threads != 1) converter.LineThreads = 1;
+
+            std::string extension = ContainerExtension(converter.Format);
+            auto rename = [&](const std::string& name) {
+                return speccybasic::MemberExtension(name) == ".txt" ? speccybasic::ReplaceMemberExtension(name, extension) : std::string();
+            };
+            auto results = speccybasic::ConvertArchive(archiveOptions, rename,
+                [&](const speccybasic::BatchJob& job, const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
+                    speccybasic::Diagnostics& warnings) {
+                    std::string_view text(reinterpret_cast<const char*>(input.data()), input.size());
+                    txt2bas::ConversionResult result = converter.Convert(text, nullptr, nullptr, &warnings);
+                    result.SetName(speccybasic::MemberStem(job.Input));
+                    if (verify) VerifyProgram(text, result, nullptr);
+                    std::string summary = SizeSummary(result, verify);
+                    output = std::move(result.FileData);
+                    return summary;
+                });
+            return speccybasic::PrintBatchReport(results, std::cout) == 0 ? 0 : 1;
+        }
+    } catch (const std::exception& ex) {
+        std::cout << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+
+    if (!args.empty() && args[0] == "--watch") {
+        if (args.size() < 2 || args.size() > 3) {
+            std::cout << "Usage: txt2bas --watch <input-dir> [<output-dir>]\n";
+            return 1;
+        }
+        return RunWatch(converter, args[1], args.size() == 3 ? args[2] : args[1], verify);
+    }
+
+    if (!args.empty() && speccybasic::IsBatchArgument(args[0])) {
+        try {
+            speccybasic::BatchOptions options = speccybasic::ParseBatchArguments(args, ContainerExtension(converter.Format));
+            if (!cacheFile.empty()) throw std::runtime_error("--cache=FILE is for single files; batch jobs each keep <output>.cache");
+            // Files are already spread across the pool, so don't split each one further
+            if (options.Threads != 1) converter.LineThreads = 1;
+
+            std::vector<speccybasic::StatsEntry> entries(options.Jobs.size());
+            auto results = speccybasic::RunBatch(options.Jobs, options.Threads, [&](const speccybasic::BatchJob& job,
+                                                                                   speccybasic::Diagnostics& warnings) {
+                speccybasic::StatsEntry& entry = entries[&job - options.Jobs.data()];
+                entry.Stats.Profile = statsOptions.Profile;
+                speccybasic::ScopedTimer totalTimer(statsOptions.Enabled ? &entry.TotalNs : nullptr);
+                std::string cachePath = useCache ? CachePath(job.Input, job.Output) : std::string();
+                return ConvertOne(converter, job.Input, job.Output, statsOptions.Enabled ? &entry.Stats : nullptr, cachePath,
+                                  verify, &warnings);
+            });
+
+            size_t failed;
+            if (statsOptions.Enabled && statsOptions.Path.empty()) {
+                // The JSON takes the place of the text report so stdout stays parseable
+                failed = std::count_if(results.begin(), results.end(), [](const speccybasic::BatchResult& r) { return !r.Success; });
+            } else {
+                failed = speccybasic::PrintBatchReport(results, std::cout);
+            }
+
+            if (statsOptions.Enabled) {
+                for (size_t n = 0; n < results.size(); n++) {
+                    entries[n].Input = results[n].Job.Input;
+                    entries[n].Output = results[n].Job.Output;
+                    entries[n].Success = results[n].Success;
+                    entries[n].Warnings = results[n].Warnings;
+                    if (!results[n].Success) entries[n].Error = results[n].Message;
+                }
+                std::string json = speccybasic::FormatStatsJson("txt2bas", TOOL_VERSION, entries,
+                                                                speccybasic::AllocationCount() - allocationsBefore, elapsedNs(), statsOptions.Profile);
+                speccybasic::WriteStatsReport(statsOptions, json, std::cout);
+            }
+            return failed == 0 ? 0 : 1;
+        } catch (const std::exception& ex) {
+            std::cout << "Error: " << ex.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (args.size() < 2) {
+        std::cout << "Usage: txt2bas <input.txt> <output.bas>\n";
+        return 0;
+    }
+
+    // Keep stdout clean for the program image when it is the output
+    std::ostream& status = (args[1] == "-") ? std::cerr : std::cout;
+    // A report without a file of its own replaces the status line
+    bool quiet = statsOptions.Enabled && statsOptions.Path.empty();
+
+    speccybasic::StatsEntry entry;
+    entry.Input = args[0];
+    entry.Output = args[1];
+    entry.Stats.Profile = statsOptions.Profile;
+
+    try {
+        std::string cachePath = !useCache ? std::string() : !cacheFile.empty() ? cacheFile : CachePath(args[0], args[1]);
+        std::string summary = ConvertOne(converter, args[0], args[1], statsOptions.Enabled ? &entry.Stats : nullptr, cachePath,
+                                         verify, &entry.Warnings);
+        entry.Success = true;
+        if (!quiet) {
+            status << "Success! Created " << (args[1] == "-" ? "stdout" : args[1]) << " (" << summary << ")\n";
+        }
+    } catch (const std::exception& ex) {
+        entry.Error = ex.what();
+        if (!quiet) status << "Error: " << ex.what() << "\n";
+    }
+    if (!quiet) PrintWarnings(args[0], entry.Warnings, std::cerr);
+
+    if (statsOptions.Enabled) {
+        entry.TotalNs = elapsedNs();
+        try {
+            std::string json = speccybasic::FormatStatsJson("txt2bas", TOOL_VERSION, { entry },
+                                                            speccybasic::AllocationCount() - allocationsBefore, entry.TotalNs, statsOptions.Profile);
+            speccybasic::WriteStatsReport(statsOptions, json, status);
+        } catch (const std::exception& ex) {
+            std::cerr << "Error: " << ex.what() << "\n";
+            return 1;
+        }
+    }
+    // A failed conversion or verify fails the run, as it does in batch mode
+    return entry.Success ? 0 : 1;
+}